@@ -0,0 +1,139 @@
+/* ata.c - polled PIO driver for the primary ATA disk
+ * vim:ts=4 noexpandtab
+ *
+ * Only the master drive on the primary bus, LBA28, one command at a time.
+ * The drive's interrupt is masked and every transfer busy-waits on the
+ * status register, so it can be used from the page fault handler with
+ * interrupts off.
+ */
+
+#include "ata.h"
+#include "lib.h"
+
+static uint32_t ata_sectors = 0; // size of the disk, 0 if there is none
+
+/* ata_delay
+ *   DESCRIPTION: gives the drive the 400ns it needs to put up a valid
+ *                status after a command or drive select
+ *   INPUT: none
+ *   OUTPUT: none
+ */
+static void ata_delay(void){
+	int i;
+	for(i = 0; i < 4; i++) inb(ATA_CONTROL);
+}
+
+/* ata_wait
+ *   DESCRIPTION: polls the status register until the drive is no longer busy
+ *   INPUT: drq - nonzero to wait for data to be ready as well
+ *   OUTPUT: 0 when ready, -1 on a drive error or timeout
+ */
+static int32_t ata_wait(int drq){
+	uint32_t status;
+	uint32_t i;
+
+	for(i = 0; i < ATA_TIMEOUT; i++){
+		status = inb(ATA_COMMAND);
+		if(status & ATA_SR_BSY) continue;
+		if(status & (ATA_SR_ERR | ATA_SR_DF)) return -1;
+		if(!drq || (status & ATA_SR_DRQ)) return 0;
+	}
+	return -1;
+}
+
+/* ata_init
+ *   DESCRIPTION: identifies the primary master and masks its interrupt
+ *   INPUT: none
+ *   OUTPUT: 1 if it is an ATA disk we can use, 0 if not
+ */
+int32_t ata_init(void){
+	uint16_t id[ATA_SECTOR_WORDS];
+	uint32_t status;
+	int i;
+
+	outb(ATA_CTL_NIEN, ATA_CONTROL);
+	outb(ATA_DRIVE_MASTER, ATA_DRIVE);
+	ata_delay();
+	if(inb(ATA_COMMAND) == 0xFF) return 0; // floating bus, no drives
+
+	outb(0, ATA_SECCOUNT);
+	outb(0, ATA_LBA_LO);
+	outb(0, ATA_LBA_MID);
+	outb(0, ATA_LBA_HI);
+	outb(ATA_CMD_IDENTIFY, ATA_COMMAND);
+	ata_delay();
+	status = inb(ATA_COMMAND);
+	if(status == 0) return 0; // no drive
+
+	for(i = 0; i < ATA_TIMEOUT && (inb(ATA_COMMAND) & ATA_SR_BSY); i++);
+	// ATAPI and SATA devices answer with a signature instead
+	if(inb(ATA_LBA_MID) != 0 || inb(ATA_LBA_HI) != 0) return 0;
+	if(ata_wait(1) == -1) return 0;
+
+	for(i = 0; i < ATA_SECTOR_WORDS; i++) id[i] = inw(ATA_DATA);
+	ata_sectors = id[ATA_ID_LBA_SECTORS] | ((uint32_t)id[ATA_ID_LBA_SECTORS + 1] << 16);
+	return ata_sectors != 0;
+}
+
+/* ata_command
+ *   DESCRIPTION: issues a read or write of sectors on the master
+ *   INPUT: lba - first sector
+ *          count - sectors, 1 ~ ATA_MAX_SECTORS
+ *          cmd - ATA_CMD_READ or ATA_CMD_WRITE
+ *   OUTPUT: 0 if the command went out, -1 if the range is off the disk
+ */
+static int32_t ata_command(uint32_t lba, uint32_t count, uint32_t cmd){
+	if(count == 0 || count > ATA_MAX_SECTORS || lba >= ata_sectors ||
+	   count > ata_sectors - lba || lba + count > ATA_LBA28_LIMIT)
+		return -1;
+	if(ata_wait(0) == -1) return -1;
+
+	outb(ATA_DRIVE_LBA | ((lba >> 24) & 0x0F), ATA_DRIVE);
+	ata_delay();
+	outb(count, ATA_SECCOUNT);
+	outb(lba & 0xFF, ATA_LBA_LO);
+	outb((lba >> 8) & 0xFF, ATA_LBA_MID);
+	outb((lba >> 16) & 0xFF, ATA_LBA_HI);
+	outb(cmd, ATA_COMMAND);
+	ata_delay();
+	return 0;
+}
+
+/* ata_read
+ *   DESCRIPTION: reads sectors from the disk
+ *   INPUT: lba - first sector
+ *          count - sectors, 1 ~ ATA_MAX_SECTORS
+ *          buf - where to put them, count * ATA_SECTOR_SIZE bytes
+ *   OUTPUT: 0 on success, -1 on a bad range or drive error
+ */
+int32_t ata_read(uint32_t lba, uint32_t count, void* buf){
+	uint16_t* dst = (uint16_t*)buf;
+	uint32_t i, j;
+
+	if(ata_command(lba, count, ATA_CMD_READ) == -1) return -1;
+	for(i = 0; i < count; i++){
+		if(ata_wait(1) == -1) return -1;
+		for(j = 0; j < ATA_SECTOR_WORDS; j++) *dst++ = inw(ATA_DATA);
+	}
+	return 0;
+}
+
+/* ata_write
+ *   DESCRIPTION: writes sectors to the disk. The drive's write cache isn't
+ *                flushed; nothing written here has to survive a reboot.
+ *   INPUT: lba - first sector
+ *          count - sectors, 1 ~ ATA_MAX_SECTORS
+ *          buf - data, count * ATA_SECTOR_SIZE bytes
+ *   OUTPUT: 0 on success, -1 on a bad range or drive error
+ */
+int32_t ata_write(uint32_t lba, uint32_t count, const void* buf){
+	const uint16_t* src = (const uint16_t*)buf;
+	uint32_t i, j;
+
+	if(ata_command(lba, count, ATA_CMD_WRITE) == -1) return -1;
+	for(i = 0; i < count; i++){
+		if(ata_wait(1) == -1) return -1;
+		for(j = 0; j < ATA_SECTOR_WORDS; j++) outw(*src++, ATA_DATA);
+	}
+	return ata_wait(0);
+}
@@ -0,0 +1,51 @@
+/* ata.h - polled PIO driver for the primary ATA disk
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef ATA_H
+#define ATA_H
+
+#include "types.h"
+
+/* primary bus registers */
+#define ATA_DATA			0x1F0
+#define ATA_ERROR			0x1F1
+#define ATA_SECCOUNT		0x1F2
+#define ATA_LBA_LO			0x1F3
+#define ATA_LBA_MID			0x1F4
+#define ATA_LBA_HI			0x1F5
+#define ATA_DRIVE			0x1F6
+#define ATA_COMMAND			0x1F7 // status when read
+#define ATA_CONTROL			0x3F6 // alternate status when read
+
+/* status bits */
+#define ATA_SR_BSY			0x80
+#define ATA_SR_DRDY			0x40
+#define ATA_SR_DF			0x20
+#define ATA_SR_DRQ			0x08
+#define ATA_SR_ERR			0x01
+
+/* commands */
+#define ATA_CMD_READ		0x20 // read sectors, LBA28
+#define ATA_CMD_WRITE		0x30 // write sectors, LBA28
+#define ATA_CMD_IDENTIFY	0xEC
+
+#define ATA_DRIVE_MASTER	0xA0 // drive select for IDENTIFY
+#define ATA_DRIVE_LBA		0xE0 // master, LBA mode; low nibble is LBA bits 24-27
+#define ATA_CTL_NIEN		0x02 // no interrupts, everything is polled
+
+#define ATA_SECTOR_SIZE		512
+#define ATA_SECTOR_WORDS	(ATA_SECTOR_SIZE / 2)
+#define ATA_MAX_SECTORS		255  // per command
+#define ATA_LBA28_LIMIT		0x10000000
+#define ATA_TIMEOUT			1000000 // status polls before giving up
+#define ATA_ID_LBA_SECTORS	60   // IDENTIFY words 60-61: LBA28 sector count
+
+/* finds the primary master; 1 if there is a usable disk, 0 if not */
+int32_t ata_init(void);
+/* reads count sectors starting at lba into buf */
+int32_t ata_read(uint32_t lba, uint32_t count, void* buf);
+/* writes count sectors starting at lba from buf */
+int32_t ata_write(uint32_t lba, uint32_t count, const void* buf);
+
+#endif /* ATA_H */
@@ -196,7 +196,8 @@ int32_t read_data(uint32_t inode, uint32_t offset, uint8_t * buf, uint32_t lengt
 		uint32_t bytes_to_copy =
 			((data_length - bytes_copied) >= DATABLOCK_SIZE)?
 				DATABLOCK_SIZE : (data_length - bytes_copied);
-		memcpy((buf+bytes_copied), datablock_ptr, bytes_to_copy);
+		if(copy_to_user((buf+bytes_copied), datablock_ptr, bytes_to_copy) != 0)
+			return -1; // buf is a user buffer that isn't mapped
 		bytes_copied += bytes_to_copy;
 
 		datablock_num_ptr += 4; // point to next datablock_num
@@ -248,8 +249,8 @@ int32_t file_close(int32_t fd){
 int32_t file_read(int32_t fd, void * buf, int32_t nbytes){
 
 	/* clear buf first */
-	memset(buf, 0, nbytes);
-	pcb_t* current_pcb = get_curr_pcb();
+	if(clear_user(buf, nbytes) != 0) return -1;
+	pcb_t* current_pcb = get_curr_proc();
 	uint32_t current_inode = current_pcb->fd_array[fd].inode;
 	uint32_t current_position = current_pcb->fd_array[fd].file_pos;
 	/* read nbytes from file into buf */
@@ -313,7 +314,8 @@ int32_t dir_read(int32_t fd, void * buf, int32_t nbytes){
 		if (copied_bytes > nbytes){
 			copied_bytes = nbytes;
 		}
-		memcpy((int8_t*)buf,(int8_t*)read_file.filename,FILENAME_SIZE/*copied_bytes*/);
+		if(copy_to_user(buf, read_file.filename, nbytes < FILENAME_SIZE ? nbytes : FILENAME_SIZE) != 0)
+			return -1;
 		++file_index;
 		return copied_bytes;
 		//return 0;
@@ -0,0 +1,94 @@
+/* futex.c - sleeping on a word of user memory
+ * vim:ts=4 noexpandtab
+ *
+ * Locks and conditions live in user memory and are taken with atomic
+ * instructions in user space; only contended cases come here. A word is
+ * known by its address space and user address, which threads share. Only
+ * in shared memory is it known by its physical address, so processes that
+ * map the segment anywhere find each other; those frames never move, while
+ * private ones may (copy-on-write, merging, swap).
+ */
+
+#include "futex.h"
+#include "lib.h"
+#include "paging.h"
+#include "sched.h"
+
+/* every futex waiter sleeps on this; futex_owner and futex_addr tell them apart */
+static uint8_t futex_chan;
+
+/* futex_key
+ *   DESCRIPTION: what a futex word is known by
+ *   INPUT: addr - user address of the word
+ *          owner, key - filled in: the leader of the current process and
+ *                       addr, or NULL and the physical address in shared memory
+ *   OUTPUT: 0 on success, -1 if addr is unaligned or not a user address
+ */
+static int32_t futex_key(uint32_t* addr, void** owner, uint32_t* key){
+	if(((uint32_t)addr & 0x3) != 0 || bad_userspace_addr(addr, sizeof(uint32_t))) return -1;
+	*key = shm_phys_addr((uint32_t)addr);
+	if(*key != 0){
+		*owner = NULL;
+		return 0;
+	}
+	*owner = get_curr_proc();
+	*key = (uint32_t)addr;
+	return 0;
+}
+
+/* futex_wait
+ *   DESCRIPTION: sleeps if the word still holds val. The check and the sleep
+ *                happen with interrupts off, so a futex_wake after the user
+ *                changed the word can't be missed.
+ *   INPUT: addr - user address of the word
+ *          val - value the caller saw
+ *   OUTPUT: 0 once woken, -1 if the word changed already or addr is bad
+ */
+int32_t futex_wait(uint32_t* addr, uint32_t val){
+	pcb_t* curr = get_curr_pcb();
+	uint32_t flags;
+	uint32_t cur, key;
+	void* owner;
+
+	cli_and_save(flags);
+	if(futex_key(addr, &owner, &key) == -1 ||
+	   copy_from_user(&cur, addr, sizeof(uint32_t)) != 0 || cur != val){
+		restore_flags(flags);
+		return -1;
+	}
+	curr->futex_owner = owner;
+	curr->futex_addr = key;
+	sleep_on(&futex_chan);
+	restore_flags(flags);
+	return 0;
+}
+
+/* futex_wake
+ *   DESCRIPTION: wakes processes sleeping on the word
+ *   INPUT: addr - user address of the word
+ *          nr - how many to wake at most
+ *   OUTPUT: number woken, -1 if addr is bad
+ */
+int32_t futex_wake(uint32_t* addr, uint32_t nr){
+	pcb_t* pcb;
+	uint32_t flags;
+	uint32_t key;
+	void* owner;
+	int32_t woken = 0;
+
+	cli_and_save(flags);
+	if(futex_key(addr, &owner, &key) == -1){
+		restore_flags(flags);
+		return -1;
+	}
+	for(pcb = process_list; pcb != NULL && (uint32_t)woken < nr; pcb = pcb->next_proc){
+		if(pcb->state == PROC_BLOCKED && pcb->wait_chan == &futex_chan &&
+		   pcb->futex_owner == owner && pcb->futex_addr == key){
+			pcb->state = PROC_RUNNABLE;
+			pcb->wait_chan = NULL;
+			woken++;
+		}
+	}
+	restore_flags(flags);
+	return woken;
+}
@@ -0,0 +1,19 @@
+/* futex.h - sleeping on a word of user memory
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include "types.h"
+
+/* futex operations */
+#define FUTEX_WAIT		0 // sleep while *addr == val
+#define FUTEX_WAKE		1 // wake up to val waiters
+
+/* sleeps until a futex_wake on the same word, unless it no longer holds val */
+int32_t futex_wait(uint32_t* addr, uint32_t val);
+/* wakes up to nr processes waiting on the word */
+int32_t futex_wake(uint32_t* addr, uint32_t nr);
+
+#endif /* FUTEX_H */
@@ -33,7 +33,8 @@ void init_idt(){
     define_exception(NUM_SEG_NOT_PRESENT,SEG_NOT_PRESENT,DPL_KERNEL);
     define_exception(NUM_STACK_FAULT,STACK_FAULT,DPL_KERNEL);
     define_exception(NUM_GENERAL_PFAULT,GENERAL_PFAULT,DPL_KERNEL);
-    define_exception(NUM_PAGE_FAULT,PAGE_FAULT,DPL_KERNEL);
+    // interrupt gate: no tick may switch away before cr2 is read
+    define_interrupt(NUM_PAGE_FAULT,PAGE_FAULT,DPL_KERNEL);
     define_exception(NUM_RESERVED,RESERVED,DPL_KERNEL);
 
     define_exception(NUM_MATH_FAULT,MATH_FAULT,DPL_KERNEL);
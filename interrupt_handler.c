@@ -11,335 +11,292 @@
 #include "i8259.h"
 #include "syscalls.h"
 #include "pit.h"
+#include "signal.h"
+
+/* fixups for faults on user memory in uaccess.S: instruction, resume point */
+extern uint32_t ex_table[];
+extern uint32_t ex_table_end[];
+
+/* search_ex_table
+ *   DESCRIPTION: looks up a faulting kernel instruction in the exception
+ *                table
+ *   INPUT: eip - faulting instruction
+ *	 OUTPUT: where to resume, 0 if the fault is not expected
+ */
+static uint32_t search_ex_table(uint32_t eip){
+	uint32_t* entry;
+	for(entry = ex_table; entry < ex_table_end; entry += 2){
+		if(entry[0] == eip) return entry[1];
+	}
+	return 0;
+}
 
 /* PAGE_FAULT_handler
  *   DESCRIPTION: called upon receiving page fault exception, first from
- *   			  a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   			  a wrapper assembly function in isr_wrapper.S. Writes to
+ *   			  copy-on-write pages and first touches of user pages are
+ *   			  resolved and retried, faults in
+ *   			  uaccess.S resume at their fixup; anything else is a
+ *   			  SIG_SEGFAULT.
+ *   INPUT: frame - registers saved by the wrapper, with the page fault
+ *                  error code pushed by the cpu
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle page fault error
  */
-extern void PAGE_FAULT_handler(){
-    cli();
-	uint8_t message[] = "PFAULT ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void PAGE_FAULT_handler(int_frame_t* frame){
+	/* entered through an interrupt gate, so interrupts are already off:
+	 * another process's fault can't overwrite cr2 before it is read */
+	uint32_t fault_addr;
+	uint32_t error_code = frame->error_code;
+	uint32_t fixup;
+	asm volatile("movl %%cr2, %0" : "=r"(fault_addr));
+
+	/* iret restores the faulting context's IF, so no sti here */
+	if((error_code & PF_PRESENT_BIT) && (error_code & PF_WRITE_BIT) &&
+	   handle_cow_fault(fault_addr) == 0)
+		return;
+	/* first touch of a user page */
+	if(!(error_code & PF_PRESENT_BIT) && handle_demand_fault(fault_addr, error_code & PF_WRITE_BIT) == 0)
+		return;
+
+	/* a user buffer the kernel copies to or from isn't mapped */
+	if((frame->cs & 0xFFFF) != USER_CS && (fixup = search_ex_table(frame->eip)) != 0){
+		frame->eip = fixup;
+		return;
+	}
+
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"PFAULT ERROR\n");
 }
 
 /* DIV_BY_ZERO_handler
  *   DESCRIPTION: called upon receiving page DIV_BY_ZERO exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle div by zero error
  */
-extern void DIV_BY_ZERO_handler(){
-    cli();
-	uint8_t message[] = "DIV_BY_ZERO_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void DIV_BY_ZERO_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_DIV_ZERO, (const uint8_t*)"DIV_BY_ZERO_ERROR\n");
 }
 
 /* SINGLE_STEP_INT_handler
  *   DESCRIPTION: called upon receiving single step int exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle single step int error
  */
-extern void SINGLE_STEP_INT_handler(){
-    cli();
-	uint8_t message[] = "SINGLE_STEP_INT_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void SINGLE_STEP_INT_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"SINGLE_STEP_INT_ERROR\n");
 }
 
 /* NMI_handler
  *   DESCRIPTION: called upon receiving NMI exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle NMI interrupt error
  */
-extern void NMI_handler(){
-    cli();
-	uint8_t message[] = "NMI_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void NMI_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"NMI_ERROR\n");
 }
 
 /* BREAKPOINT_handler
  *   DESCRIPTION: called upon receiving breakpoint exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle breakpoint(int3) error
  */
-extern void BREAKPOINT_handler(){
-    cli();
-	uint8_t message[] = "BREAKPOINT(INT3)_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void BREAKPOINT_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"BREAKPOINT(INT3)_ERROR\n");
 }
 
 /* OVERFLOW_handler
  *   DESCRIPTION: called upon receiving overflow exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle overflow(into) error
  */
-extern void OVERFLOW_handler(){
-    cli();
-	uint8_t message[] = "OVERFLOW(INTO)_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void OVERFLOW_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"OVERFLOW(INTO)_ERROR\n");
 }
 
 /* BOUNDS_handler
  *   DESCRIPTION: called upon receiving Bounds range exceeded exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle bounds range exceeded error
  */
-extern void BOUNDS_handler(){
-    cli();
-	uint8_t message[] = "BOUNDS_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void BOUNDS_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"BOUNDS_ERROR\n");
 }
 
 /* INVALID_OPCODE_handler
  *   DESCRIPTION: called upon receiving Invalid Opcode(UD2) exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle Invalid Opcode(UD2) error
  */
-extern void INVALID_OPCODE_handler(){
-    cli();
-	uint8_t message[] = "INVALID_OPCODE(UD2)_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void INVALID_OPCODE_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"INVALID_OPCODE(UD2)_ERROR\n");
 }
 
 /* COPROCESSOR_NA_handler
  *   DESCRIPTION: called upon receiving Coprocessor_NA exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle coprocssor_N/A error
  */
-extern void COPROCESSOR_NA_handler(){
-    cli();
-	uint8_t message[] = "COPROCESSOR_NA_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void COPROCESSOR_NA_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"COPROCESSOR_NA_ERROR\n");
 }
 
 /* DOUBLE_FAULT_handler
  *   DESCRIPTION: called upon receiving Double Fault exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle Double Fault error
  */
-extern void DOUBLE_FAULT_handler(){
-    cli();
-	uint8_t message[] = "DOUBLE_FAULT_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void DOUBLE_FAULT_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"DOUBLE_FAULT_ERROR\n");
 }
 
 /* COPROCESSOR_SO_handler
  *   DESCRIPTION: called upon receiving Coprocessor_SO exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle coprocssor_SO error
  */
-extern void COPROCESSOR_SO_handler(){
-    cli();
-	uint8_t message[] = "COPROCESSOR_SO_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void COPROCESSOR_SO_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"COPROCESSOR_SO_ERROR\n");
 }
 
 /* INVALID_TSS_handler
  *   DESCRIPTION: called upon receiving INVALID_TSS exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle INVALID_TSS error
  */
-extern void INVALID_TSS_handler(){
-    cli();
-	uint8_t message[] = "INVALID_TSS_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void INVALID_TSS_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"INVALID_TSS_ERROR\n");
 }
 
 /* SEG_NOT_PRESENT_handler
  *   DESCRIPTION: called upon receiving Segment not present exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle SEG_NOT_PRESENT error
  */
-extern void SEG_NOT_PRESENT_handler(){
-    cli();
-	uint8_t message[] = "SEG_NOT_PRESENT_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void SEG_NOT_PRESENT_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"SEG_NOT_PRESENT_ERROR\n");
 }
 
 /* STACK_FAULT_handler
  *   DESCRIPTION: called upon receiving STACK_FAULT exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle STACK_FAULT error
  */
-extern void STACK_FAULT_handler(){
-    cli();
-	uint8_t message[] = "STACK_FAULT_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void STACK_FAULT_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"STACK_FAULT_ERROR\n");
 }
 
 /* GENERAL_PFAULT_handler
  *   DESCRIPTION: called upon receiving General Pfault exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle General Pfault error
  */
-extern void GENERAL_PFAULT_handler(){
-    cli();
-	uint8_t message[] = "GENERAL_PFAULT_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void GENERAL_PFAULT_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"GENERAL_PFAULT_ERROR\n");
 }
 
 /* RESERVED_handler
  *   DESCRIPTION: called upon receiving an exception signal on the reserved
  *   			  spot, first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: executes code when receiving reserved signal
  */
-extern void RESERVED_handler(){
-    cli();
-	uint8_t message[] = "RESERVED_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void RESERVED_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"RESERVED_ERROR\n");
 }
 
 /* MATH_FAULT_handler
  *   DESCRIPTION: called upon receiving MATH_FAULT exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle math fault error
  */
-extern void MATH_FAULT_handler(){
-    cli();
-	uint8_t message[] = "MATH_FAULT\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void MATH_FAULT_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"MATH_FAULT\n");
 }
 
 /* ALIGNMENT_CHECK_handler
  *   DESCRIPTION: called upon receiving ALIGNMENT_CHECK exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle alignment check error
  */
-extern void ALIGNMENT_CHECK_handler(){
-    cli();
-	uint8_t message[] = "ALIGNMENT_CHECK_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void ALIGNMENT_CHECK_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"ALIGNMENT_CHECK_ERROR\n");
 }
 
 /* MACHINE_CHECK_handler
  *   DESCRIPTION: called upon receiving MACHINE_CHECK exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle machine check error
  */
-extern void MACHINE_CHECK_handler(){
-    cli();
-	uint8_t message[] = "MACHINE_CHECK_ERROR\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void MACHINE_CHECK_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"MACHINE_CHECK_ERROR\n");
 }
 
 /* SIMD_FP_EXCEP_handler
  *   DESCRIPTION: called upon receiving SIMD floating-point exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle SIMD_FP_EXCEP error
  */
-extern void SIMD_FP_EXCEP_handler(){
-    cli();
-	uint8_t message[] = "SIMD_FP_EXCEPTION\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void SIMD_FP_EXCEP_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"SIMD_FP_EXCEPTION\n");
 }
 
 /* VIRTUAL_EXCEP_handler
  *   DESCRIPTION: called upon receiving virtualization exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle virtualization error
  */
-extern void VIRTUAL_EXCEP_handler(){
-    cli();
-	uint8_t message[] = "VIRTUALIZATION_EXCEPTION\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void VIRTUAL_EXCEP_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"VIRTUALIZATION_EXCEPTION\n");
 }
 
 /* CTRL_PROT_EXCEP_handler
  *   DESCRIPTION: called upon receiving control protection exception,
  *   			  first from a wrapper assembly function in isr_wrapper.S
- *   INPUT: none
+ *   INPUT: frame - registers saved by the wrapper in isr_wrapper.S
  *	 OUTPUT: none
  *	 SIDE EFFECTS: handle control protection exception  error
  */
-extern void CTRL_PROT_EXCEP_handler(){
-    cli();
-	uint8_t message[] = "CONTROL_PROTECTION_EXCEPTION\n";
-	terminal_write(0,message,strlen((const int8_t*)message));
-	halt(-1);
-  	sti();
+extern void CTRL_PROT_EXCEP_handler(int_frame_t* frame){
+	exception_signal(frame, SIG_SEGFAULT, (const uint8_t*)"CONTROL_PROTECTION_EXCEPTION\n");
 }
 
 
@@ -6,50 +6,61 @@
 #ifndef INTERRUPT_HANDLER_H
 #define INTERRUPT_HANDLER_H
 
+#include "types.h"
+
+/* what the isr_wrapper.S wrappers leave on the stack for exceptions and
+ * interrupts; esp and ss are only there when coming from user mode */
+typedef struct int_frame_t{
+	uint32_t edi, esi, ebp, esp_kernel, ebx, edx, ecx, eax; // pushal
+	uint32_t error_code; // pushed by the cpu, or 0 by the wrapper
+	uint32_t eip, cs, eflags;
+	uint32_t esp, ss;
+}int_frame_t;
+
 /* Handler functions for exceptions below */
-extern void PAGE_FAULT_handler();
+extern void PAGE_FAULT_handler(int_frame_t* frame);
 
-extern void DIV_BY_ZERO_handler();
+extern void DIV_BY_ZERO_handler(int_frame_t* frame);
 
-extern void SINGLE_STEP_INT_handler();
+extern void SINGLE_STEP_INT_handler(int_frame_t* frame);
 
-extern void NMI_handler();
+extern void NMI_handler(int_frame_t* frame);
 
-extern void BREAKPOINT_handler();
+extern void BREAKPOINT_handler(int_frame_t* frame);
 
-extern void OVERFLOW_handler();
+extern void OVERFLOW_handler(int_frame_t* frame);
 
-extern void BOUNDS_handler();
+extern void BOUNDS_handler(int_frame_t* frame);
 
-extern void INVALID_OPCODE_handler();
+extern void INVALID_OPCODE_handler(int_frame_t* frame);
 
-extern void COPROCESSOR_NA_handler();
+extern void COPROCESSOR_NA_handler(int_frame_t* frame);
 
-extern void DOUBLE_FAULT_handler();
+extern void DOUBLE_FAULT_handler(int_frame_t* frame);
 
-extern void COPROCESSOR_SO_handler();
+extern void COPROCESSOR_SO_handler(int_frame_t* frame);
 
-extern void INVALID_TSS_handler();
+extern void INVALID_TSS_handler(int_frame_t* frame);
 
-extern void SEG_NOT_PRESENT_handler();
+extern void SEG_NOT_PRESENT_handler(int_frame_t* frame);
 
-extern void STACK_FAULT_handler();
+extern void STACK_FAULT_handler(int_frame_t* frame);
 
-extern void GENERAL_PFAULT_handler();
+extern void GENERAL_PFAULT_handler(int_frame_t* frame);
 
-extern void RESERVED_handler();
+extern void RESERVED_handler(int_frame_t* frame);
 
-extern void MATH_FAULT_handler();
+extern void MATH_FAULT_handler(int_frame_t* frame);
 
-extern void ALIGNMENT_CHECK_handler();
+extern void ALIGNMENT_CHECK_handler(int_frame_t* frame);
 
-extern void MACHINE_CHECK_handler();
+extern void MACHINE_CHECK_handler(int_frame_t* frame);
 
-extern void SIMD_FP_EXCEP_handler();
+extern void SIMD_FP_EXCEP_handler(int_frame_t* frame);
 
-extern void VIRTUAL_EXCEP_handler();
+extern void VIRTUAL_EXCEP_handler(int_frame_t* frame);
 
-extern void CTRL_PROT_EXCEP_handler();
+extern void CTRL_PROT_EXCEP_handler(int_frame_t* frame);
 
 /* IRQ line handlers */
 extern void IRQ_KEYBOARD_handler();
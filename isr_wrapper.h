@@ -39,6 +39,8 @@ void IRQ_PIT();
 
 /* System calls */
 void SYSTEM_CALL();
+void CHILD_RETURN();
+void SYSCALL_RETURN();
 
 #endif
 #endif
@@ -16,6 +16,8 @@
 #include "paging.h"
 #include "filesystem.h"
 #include "pit.h"
+#include "slab.h"
+#include "swap.h"
 #define RUN_TESTS
 
 /* Macros. */
@@ -27,6 +29,7 @@
 void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
+    uint32_t swap_slots;
 
     /* Clear the screen. */
     clear();
@@ -156,8 +159,16 @@ void entry(unsigned long magic, unsigned long addr) {
 	/* Init the RTC */
     rtc_init();
 
-	/* Init paging */
+	/* Init the frame pool while mbi is still reachable, then paging */
+    init_frame_pool(mbi);
     init_paging();
+    slab_init();
+    printf("frame pool: %uKB free of %uKB\n", frames_free() << 2, (frames_free() + frames_used()) << 2);
+
+	/* Swap on the disk's swap partition, if it has one */
+    swap_slots = swap_init();
+    if (swap_slots != 0) printf("swap: %uKB\n", swap_slots << 2);
+    else printf("swap: off (no partition of type 0x82)\n");
 
 	/* Init filesystem */
 	filesystem_init();
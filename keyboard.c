@@ -5,6 +5,9 @@
 #include "idt.h"
 #include "terminal.h"
 #include "pit.h"
+#include "signal.h"
+#include "sched.h"
+#include "slab.h"
 //mod flags
 //unsigned int cursor_x,cursor_y;
 unsigned char ctrl_flag, alt_flag, shift_flag, caps_flag; //flags for handling mods
@@ -53,7 +56,7 @@ unsigned int scantable_small[5][69] = {
     KEY_UNKNOWN, KEY_ESCAPE, '1', '2', '3', '4', '5', '6', '7', '8', '9', '0', '-', '=',	KEY_BACKSPACE,
     KEY_TAB, 'q',	'w', 'e', 'r', 't', 'y', 'u', 'i', 'o', 'p', '[', ']', KEY_RETURN,
     KEY_LCTRL, 'a', 's', 'd', 'f', 'g', 'h', 'j', 'k', CRL, ';', '\'', '`',
-    KEY_LSHIFT, '\\', 'z', 'x', 'c', 'v', 'b', 'n', 'm', ',', '.', '/', KEY_RSHIFT,
+    KEY_LSHIFT, '\\', 'z', 'x', CRC, 'v', 'b', 'n', 'm', ',', '.', '/', KEY_RSHIFT,
     '*', KEY_RALT, ' ',	KEY_CAPSLOCK,	KEY_F1, KEY_F2,	KEY_F3,	KEY_F4,	KEY_F5,	KEY_F6,	KEY_F7,	KEY_F8,	KEY_F9,	KEY_F10
   },
   { //NORMAL
@@ -175,6 +178,13 @@ unsigned char translate(unsigned int scan)
       return ascii;
     }
 
+    //Ctrl+C interrupts the foreground program of the shown terminal
+    if(ascii == CRC && ctrl_flag == 1){
+      if(terminal_arr[terminal_num_display].most_recent_pcb != NULL)
+        send_signal(terminal_arr[terminal_num_display].most_recent_pcb, SIG_INTERRUPT);
+      return ascii;
+    }
+
     //hack to paste buffer
     else if(ascii == DBH && alt_flag == 1){
       uint8_t i = 0;
@@ -186,8 +196,10 @@ unsigned char translate(unsigned int scan)
       printf("|");
     }
     //enter code
-    else if(ascii == KEY_RETURN)
+    else if(ascii == KEY_RETURN){
       enter_flag = 1;
+      wake_up(&enter_flag); // terminal_read and poll
+    }
     //add normal key to buffer
     else{
       buf_flag = 3;
@@ -368,9 +380,13 @@ void swap_terminal(uint8_t index){
   if(index == terminal_num_display){
     return;
   }
+  /* swap the content of physical video memory, through a buffer off the
+   * (8KB) kernel stack */
+  char* temp = (char*)kmalloc(SIZE_OF_VIDMEM);
+  if(temp == NULL){
+    return;
+  }
   cli();
-	/* swap the content of physical video memory */
-  char temp[SIZE_OF_VIDMEM];
 	/* 1. save physical vidmem to one of three terminals */
   memcpy(temp,terminal_arr[index].vidmem_addr,SIZE_OF_VIDMEM);
 
@@ -381,9 +397,11 @@ void swap_terminal(uint8_t index){
 	/* 2. put indexed video mmr to physical video mmr */
 	memcpy(terminal_arr[index].vidmem_addr, temp,SIZE_OF_VIDMEM);
   terminal_num_display = index;
+  wake_up(&enter_flag); // a pending line may belong to the new terminal
 
 	/* 3. set paging to reflect new video memory being loaded */
 
   update_cursor(terminal_arr[terminal_num_display].cursor_x,terminal_arr[terminal_num_display].cursor_y);
+  kfree(temp);
   sti();
 }
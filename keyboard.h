@@ -43,6 +43,7 @@
 #define KEY_F3 115
 #define DBH 118 //debug buffer hack
 #define CRL 119 //ctrl+l symbol
+#define CRC 3 //ctrl+c symbol (ascii ETX)
 
 //define symbols from scancodes to ignore
 #define ESC 1
@@ -30,9 +30,18 @@ void slow_memcpy(char * const destination, char const * const source, uint32_t c
 
 
 /* Userspace address-check functions */
+/* 1 if [addr, addr + len) is not all in the user part of the address space */
 int32_t bad_userspace_addr(const void* addr, int32_t len);
+/* strncpy from a user string, -1 if it faulted (uaccess.S) */
 int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
 
+/* Userspace copies; they return the number of bytes left undone when a user
+ * page faults (uaccess.S). The caller checks the range with
+ * bad_userspace_addr; kernel buffers are fine too. */
+uint32_t copy_to_user(void* dest, const void* src, uint32_t n);
+uint32_t copy_from_user(void* dest, const void* src, uint32_t n);
+uint32_t clear_user(void* dest, uint32_t n);
+
 /* Port read functions */
 /* Inb reads a byte and returns its value as a zero-extended 32-bit
  * unsigned int */
@@ -2,9 +2,80 @@
 #include "lib.h"
 #include "pit.h"
 #include "syscalls.h"
+#include "sched.h"
+#include "multiboot.h"
+#include "swap.h"
 
 #define VID_MEM_OFFSET 0xb8
 
+/* reference count of every frame in the user frame pool; 0 means free */
+static uint16_t user_frame_ref[USER_FRAME_NUM];
+/* next-fit hint for alloc_user_frame */
+static uint32_t next_user_frame = 0;
+/* frames of the pool that are RAM, and how many of them are free */
+static uint32_t total_frame_count = 0;
+static uint32_t free_frame_count = 0;
+/* page directory cr3 points at: the kernel's own until a process runs */
+static PDE_t* cur_page_dir = Page_Directory_Entry;
+/* address space cr3 points at, NULL for the kernel's own */
+static user_mem_t* cur_mem = NULL;
+/* the shared read-only page of zeros untouched anonymous memory maps; it is
+ * not reference counted, get/put_user_frame ignore it */
+static uint32_t zero_frame = 0;
+/* frames zeroed ahead of time by the idle loop (stack) */
+static uint32_t zeroed_frames[ZERO_POOL_SIZE];
+static uint32_t zeroed_count = 0;
+/* PTE_PAT_BIT if VGA memory can be mapped write-combining, 0 if not */
+static uint32_t video_mem_type = 0;
+/* off-screen video buffers of the terminals */
+static uint32_t vid_buf_frame[NUM_TERMINALS];
+/* swap slot (+1, 0 for none) still holding a copy of a frame read back in;
+ * while the page isn't dirtied it can go out again without being written */
+static uint16_t frame_swap_slot[USER_FRAME_NUM];
+/* reclaim clock hand: address space (by leader pid) and page in it */
+static uint32_t clock_pid = 0;
+static uint32_t clock_page = 0;
+/* same-page merging: checksum of every frame at its last look, frames that
+ * are write-protected everywhere and hashed so others can merge with them
+ * (bit set), and the hash table of those by checksum */
+static uint32_t frame_csum[USER_FRAME_NUM];
+static uint32_t frame_mergeable[USER_FRAME_NUM / 32];
+static uint32_t merge_table[MERGE_TABLE_SIZE];
+static uint32_t zero_csum = 0;
+/* where the merge scan is (like the clock hand), if in a pass, and the pit
+ * tick the next pass starts at */
+static uint32_t merge_hand_pid = 0;
+static uint32_t merge_hand_page = 0;
+static int merge_active = 0;
+static uint32_t merge_next_pass = 0;
+
+static void set_heap_directory(user_mem_t* mem);
+static uint32_t page_csum(uint32_t frame_addr);
+
+/* init_pat
+ *   DESCRIPTION: makes PAT entry 4 write-combining, if the cpu has a PAT, so
+ *                character writes to VGA memory go out in bursts instead of
+ *                one uncached byte at a time. The terminals' off-screen
+ *                buffers are ordinary RAM, already write-back cached, and
+ *                stay so (the pool mapping of the same frames is write-back
+ *                and must not disagree).
+ *   INPUT: none
+ *	 OUTPUT: none
+ *	 SIDE EFFECTS: writes IA32_PAT, sets video_mem_type
+ */
+static void init_pat(void){
+  uint32_t eax, ebx, ecx, edx, lo, hi;
+
+  asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+  if (!(edx & CPUID_PAT_BIT)) return;
+
+  rdmsr(IA32_PAT_MSR, lo, hi);
+  hi = (hi & ~PAT_ENTRY_MASK) | PAT_TYPE_WC;
+  asm volatile("wbinvd" : : : "memory");
+  wrmsr(IA32_PAT_MSR, lo, hi);
+  video_mem_type = PTE_PAT_BIT;
+}
+
 /* init_paging
  *   DESCRIPTION: initialize paging for the initial boot
  *   INPUT: none
@@ -15,19 +86,20 @@ void init_paging(){
 
   int i; //iterator
 
+  init_pat();
   for (i = 0; i < NUM_PTE; i++){
     /* initialize page directory */
     Page_Directory_Entry[i].val = READ_WRITE_BIT; // only read_write is 1
 
     /* initialize page table */
     if (i == VID_MEM_OFFSET){ // video memory
-      Page_Table_Entry[i].val = (i * ADDR_START_OFFSET) | READ_WRITE_BIT | PRESENT_BIT; //the address starts at 13th bit (0x1000), read/write = 1, present = 1, supervisor = 0;
+      Page_Table_Entry[i].val = (i * ADDR_START_OFFSET) | video_mem_type | GLOBAL_BIT | READ_WRITE_BIT | PRESENT_BIT; //the address starts at 13th bit (0x1000), write-combining, global, read/write = 1, present = 1, supervisor = 0;
     }
     else { // everything else
       Page_Table_Entry[i].val = (i * ADDR_START_OFFSET) | READ_WRITE_BIT; //the address starts at 13th bit (0x1000), read/write = 1, present = 0, supervisor = 0;
     }
+    Page_Table_Entry_For_Video[i].val = READ_WRITE_BIT;
   }
-  Page_Table_Entry_For_Video[i].val = READ_WRITE_BIT;
   /* connecting page directory with page table */
   // the first pde is present
   Page_Directory_Entry[0].present = 1; //attributes : supervisor, read/write, present
@@ -39,6 +111,13 @@ void init_paging(){
   Page_Directory_Entry[1].read_write = 1; //attributes : supervisor, read/write, present
   Page_Directory_Entry[1].page_size = 1; // 4MB size page
   Page_Directory_Entry[1].page_table_addr = (KERNEL_SPACE_OFFSET >> ALIGN); // 4KB aligned
+  Page_Directory_Entry[1].val |= GLOBAL_BIT; // same in every address space
+
+  // map the user frame pool 1:1 with 4MB supervisor pages, so the kernel can
+  // copy and clear frames without going through a process's mapping
+  for (i = (USER_FRAME_POOL_START >> DENTRY_SHIFT_OFFSET); i < (USER_FRAME_POOL_END >> DENTRY_SHIFT_OFFSET); i++){
+    Page_Directory_Entry[i].val = (i << DENTRY_SHIFT_OFFSET) | GLOBAL_BIT | PAGE_SIZE_BIT | READ_WRITE_BIT | PRESENT_BIT;
+  }
 
   // set up paging (connect cr3 with PDE[0])
   asm volatile(
@@ -48,8 +127,11 @@ void init_paging(){
                  "orl $0x00000010, %%eax;"
                  "movl %%eax, %%cr4;"
                  "movl %%cr0, %%eax;"
-                 "orl $0x80000000, %%eax;"
-                 "movl %%eax, %%cr0;"
+                 "orl $0x80010000, %%eax;" // paging + WP, so kernel writes to
+                 "movl %%eax, %%cr0;"      // copy-on-write pages fault too
+                 "movl %%cr4, %%eax;"
+                 "orl $0x00000080, %%eax;" // PGE: global entries survive cr3 loads
+                 "movl %%eax, %%cr4;"
                  :                      /* no outputs */
                  :"r"(Page_Directory_Entry)    /* input */
                  :"%eax"                /* clobbered register */
@@ -57,58 +139,1131 @@ void init_paging(){
 
 }
 
-/* set_process_memory
- *   DESCRIPTION: sets up extended paging (w/o Page Table) for the process
- *   INPUT: PID - process ID number to open
+/* mark_frames
+ *   DESCRIPTION: sets the reference count of the pool frames a physical
+ *                range touches (for init_frame_pool)
+ *   INPUT: start, end - physical range, end exclusive; clipped to the pool
+ *          ref - 0 for free RAM, FRAME_RESERVED for anything else
+ *	 OUTPUT: none
+ */
+static void mark_frames(uint32_t start, uint32_t end, uint16_t ref){
+  uint32_t idx;
+
+  if (start < USER_FRAME_POOL_START) start = USER_FRAME_POOL_START;
+  if (end > USER_FRAME_POOL_END) end = USER_FRAME_POOL_END;
+  if (end <= start) return;
+  if (ref == 0){
+    // only frames wholly inside the range are usable
+    start = (start + FRAME_SIZE - 1) & FRAME_MASK;
+    end &= FRAME_MASK;
+  }
+  for (idx = (start - USER_FRAME_POOL_START) >> ALIGN;
+       idx < USER_FRAME_NUM && USER_FRAME_POOL_START + (idx << ALIGN) < end; idx++){
+    if (user_frame_ref[idx] == FRAME_RESERVED && ref == 0) total_frame_count++;
+    if (user_frame_ref[idx] == 0 && ref == FRAME_RESERVED) total_frame_count--;
+    user_frame_ref[idx] = ref;
+  }
+}
+
+/* init_frame_pool
+ *   DESCRIPTION: finds out which frames of the pool are RAM from the boot
+ *                loader's memory map (or mem_upper without one), keeps boot
+ *                modules out of it and takes the terminals' video buffers.
+ *                Runs before paging is on, while mbi is still reachable.
+ *   INPUT: mbi - multiboot information
+ *	 OUTPUT: none
+ */
+void init_frame_pool(multiboot_info_t* mbi){
+  memory_map_t* mmap;
+  module_t* mod;
+  uint32_t i;
+
+  for (i = 0; i < USER_FRAME_NUM; i++) user_frame_ref[i] = FRAME_RESERVED;
+
+  if (mbi->flags & MULTIBOOT_INFO_MMAP){
+    for (mmap = (memory_map_t*)mbi->mmap_addr;
+         (uint32_t)mmap < mbi->mmap_addr + mbi->mmap_length;
+         mmap = (memory_map_t*)((uint32_t)mmap + mmap->size + sizeof(mmap->size))){
+      if (mmap->type != MMAP_TYPE_RAM || mmap->base_addr_high != 0) continue;
+      if (mmap->length_high != 0 || mmap->base_addr_low + mmap->length_low < mmap->base_addr_low)
+        mark_frames(mmap->base_addr_low, USER_FRAME_POOL_END, 0); // runs past 4GB
+      else
+        mark_frames(mmap->base_addr_low, mmap->base_addr_low + mmap->length_low, 0);
+    }
+  }
+  else if (mbi->flags & MULTIBOOT_INFO_MEM){
+    /* mem_upper: KB of RAM from 1MB up */
+    mark_frames(0x100000, 0x100000 + (mbi->mem_upper << 10), 0);
+  }
+  else {
+    mark_frames(USER_FRAME_POOL_START, USER_FRAME_POOL_FALLBACK_END, 0);
+  }
+
+  if (mbi->flags & MULTIBOOT_INFO_MODS){
+    mod = (module_t*)mbi->mods_addr;
+    for (i = 0; i < mbi->mods_count; i++, mod++)
+      mark_frames(mod->mod_start, mod->mod_end, FRAME_RESERVED);
+  }
+
+  free_frame_count = total_frame_count;
+  for (i = 0; i < NUM_TERMINALS; i++){
+    vid_buf_frame[i] = alloc_user_frame();
+    if (vid_buf_frame[i] != 0) memset((void*)vid_buf_frame[i], 0, FRAME_SIZE);
+  }
+  zero_frame = alloc_user_frame();
+  if (zero_frame != 0){
+    memset((void*)zero_frame, 0, FRAME_SIZE);
+    zero_csum = page_csum(zero_frame);
+  }
+}
+
+/* alloc_user_frame
+ *   DESCRIPTION: hands out a free 4KB frame from the user frame pool
+ *   INPUT: none
+ *	 OUTPUT: physical address of the frame, 0 if the pool is exhausted
+ *	 SIDE EFFECTS: frame's reference count becomes 1
+ */
+uint32_t alloc_user_frame(void){
+  uint32_t i, idx;
+
+  if (free_frame_count == 0){
+    // last resort: the frames kept zeroed for later
+    if (zeroed_count > 0) return zeroed_frames[--zeroed_count];
+    return 0;
+  }
+
+  for (i = 0; i < USER_FRAME_NUM; i++){
+    idx = (next_user_frame + i) % USER_FRAME_NUM;
+    if (user_frame_ref[idx] == 0){
+      user_frame_ref[idx] = 1;
+      free_frame_count--;
+      next_user_frame = (idx + 1) % USER_FRAME_NUM;
+      return USER_FRAME_POOL_START + (idx << ALIGN);
+    }
+  }
+  return 0;
+}
+
+/* alloc_zeroed_frame
+ *   DESCRIPTION: hands out a frame filled with zeros, from the frames the
+ *                idle loop zeroed if there are any left
+ *   INPUT: none
+ *	 OUTPUT: physical address of the frame, 0 if the pool is exhausted
+ *	 SIDE EFFECTS: frame's reference count becomes 1
+ */
+uint32_t alloc_zeroed_frame(void){
+  uint32_t flags;
+  uint32_t frame;
+
+  cli_and_save(flags);
+  if (zeroed_count > 0){
+    frame = zeroed_frames[--zeroed_count];
+    restore_flags(flags);
+    return frame;
+  }
+  frame = alloc_user_frame();
+  restore_flags(flags);
+
+  if (frame != 0) memset((void*)frame, 0, FRAME_SIZE);
+  return frame;
+}
+
+/* zero_idle_frame
+ *   DESCRIPTION: zeroes one more frame ahead of time, for the idle loop.
+ *                Interrupts are on while the frame is cleared, so the cpu
+ *                stays as responsive as it is in hlt.
+ *   INPUT: none (called with interrupts off)
+ *	 OUTPUT: 1 if a frame was zeroed, 0 if there are enough already or
+ *           frames are short
+ */
+int32_t zero_idle_frame(void){
+  uint32_t frame;
+
+  if (zeroed_count >= ZERO_POOL_SIZE || free_frame_count <= ZERO_POOL_SIZE) return 0;
+  frame = alloc_user_frame();
+  if (frame == 0) return 0;
+
+  sti();
+  memset((void*)frame, 0, FRAME_SIZE);
+  cli();
+  // interrupt handlers only take from the stack, so there is room
+  zeroed_frames[zeroed_count++] = frame;
+  return 1;
+}
+
+/* alloc_frame_run
+ *   DESCRIPTION: hands out free frames next to each other, aligned to their
+ *                total size
+ *   INPUT: frames - how many, a power of two
+ *	 OUTPUT: physical address of the first frame, 0 if there is no such run
+ *	 SIDE EFFECTS: the frames' reference counts become 1
+ */
+static uint32_t alloc_frame_run(uint32_t frames){
+  uint32_t i, j, idx;
+
+  if (free_frame_count < frames) return 0;
+
+  for (i = 0; i < USER_FRAME_NUM; i += frames){
+    idx = (next_user_frame + i) % USER_FRAME_NUM;
+    idx -= idx % frames;
+    for (j = 0; j < frames && user_frame_ref[idx + j] == 0; j++);
+    if (j == frames){
+      for (j = 0; j < frames; j++) user_frame_ref[idx + j] = 1;
+      free_frame_count -= frames;
+      return USER_FRAME_POOL_START + (idx << ALIGN);
+    }
+  }
+  return 0;
+}
+
+/* alloc_kernel_stack
+ *   DESCRIPTION: hands out two free frames next to each other, aligned to
+ *                their size, for a kernel stack (and the pcb at its bottom)
+ *   INPUT: none
+ *	 OUTPUT: physical (= kernel virtual) address of the stack's low end,
+ *           0 if the pool has no such pair left
+ *	 SIDE EFFECTS: both frames' reference counts become 1
+ */
+uint32_t alloc_kernel_stack(void){
+  return alloc_frame_run(KERNEL_STACK_FRAMES);
+}
+
+/* free_kernel_stack
+ *   DESCRIPTION: gives the frames of a kernel stack back to the pool
+ *   INPUT: stack_addr - low end of the stack
+ *	 OUTPUT: none
+ */
+void free_kernel_stack(uint32_t stack_addr){
+  put_user_frame(stack_addr);
+  put_user_frame(stack_addr + FRAME_SIZE);
+}
+
+/* alloc_large_frame
+ *   DESCRIPTION: hands out a 4MB aligned run of 1024 free frames, fit for
+ *                mapping with one 4MB page
+ *   INPUT: none
+ *	 OUTPUT: physical address of the frame, 0 if there is no such run
+ *	 SIDE EFFECTS: the frames' reference counts become 1
+ */
+uint32_t alloc_large_frame(void){
+  return alloc_frame_run(LARGE_FRAME_FRAMES);
+}
+
+/* free_large_frame
+ *   DESCRIPTION: gives the frames of a 4MB frame back to the pool
+ *   INPUT: frame_addr - physical address of the frame
  *	 OUTPUT: none
- *	 SIDE EFFECTS: enables paging in the memory space in user space depending on the PID
  */
-void set_process_memory(uint32_t PID){
+void free_large_frame(uint32_t frame_addr){
+  uint32_t i;
+  for (i = 0; i < LARGE_FRAME_FRAMES; i++) put_user_frame(frame_addr + (i << ALIGN));
+}
+
+/* get_user_frame
+ *   DESCRIPTION: adds a reference to a frame that is being shared
+ *   INPUT: frame_addr - physical address of the frame
+ *	 OUTPUT: none
+ */
+void get_user_frame(uint32_t frame_addr){
+  if (frame_addr == zero_frame) return;
+  user_frame_ref[(frame_addr - USER_FRAME_POOL_START) >> ALIGN]++;
+}
+
+/* put_user_frame
+ *   DESCRIPTION: drops a reference to a frame; the frame is free again once
+ *                nobody references it
+ *   INPUT: frame_addr - physical address of the frame
+ *	 OUTPUT: none
+ */
+void put_user_frame(uint32_t frame_addr){
+  uint32_t idx = (frame_addr - USER_FRAME_POOL_START) >> ALIGN;
+  if (frame_addr == zero_frame) return;
+  if (user_frame_ref[idx] > 0 && user_frame_ref[idx] != FRAME_RESERVED &&
+      --user_frame_ref[idx] == 0){
+    free_frame_count++;
+    frame_mergeable[idx >> 5] &= ~(1 << (idx & 31));
+    if (frame_swap_slot[idx] != 0){
+      swap_free(frame_swap_slot[idx] - 1);
+      frame_swap_slot[idx] = 0;
+    }
+  }
+}
+
+/* drop_swap_copy
+ *   DESCRIPTION: forgets the swap slot kept for a frame read back from swap.
+ *                Called when the frame gets mapped somewhere else: its
+ *                contents may then have been dirtied through a mapping whose
+ *                dirty bit the new one doesn't carry.
+ *   INPUT: frame_addr - physical address of the frame
+ *	 OUTPUT: none
+ */
+static void drop_swap_copy(uint32_t frame_addr){
+  uint32_t idx = (frame_addr - USER_FRAME_POOL_START) >> ALIGN;
+
+  if (frame_addr == zero_frame || frame_swap_slot[idx] == 0) return;
+  swap_free(frame_swap_slot[idx] - 1);
+  frame_swap_slot[idx] = 0;
+}
+
+/* frames_free
+ *   DESCRIPTION: number of free 4KB frames in the pool
+ *   INPUT: none
+ *	 OUTPUT: the count
+ */
+uint32_t frames_free(void){
+  return free_frame_count;
+}
+
+/* frames_used
+ *   DESCRIPTION: number of 4KB frames of RAM in the pool that are in use
+ *   INPUT: none
+ *	 OUTPUT: the count
+ */
+uint32_t frames_used(void){
+  return total_frame_count - free_frame_count;
+}
+
+/* release_page_table
+ *   DESCRIPTION: drops the frames (and swap slots) mapped by a user page
+ *                table, then the table itself
+ *   INPUT: table - page table to release
+ *	 OUTPUT: none
+ */
+static void release_page_table(PTE_t* table){
+  int i;
+  for (i = 0; i < NUM_PTE; i++){
+    if (table[i].present) put_user_frame(table[i].val & FRAME_MASK);
+    else if (table[i].val & PTE_SWAP_BIT) swap_free(table[i].val >> ALIGN);
+  }
+  put_user_frame((uint32_t)table);
+}
+
+/* add_resident
+ *   DESCRIPTION: counts pages mapped into or out of an address space
+ *   INPUT: mem - the address space, may be NULL (nothing to count)
+ *          pages - pages mapped, negative for unmapped
+ *	 OUTPUT: none
+ */
+static void add_resident(user_mem_t* mem, int32_t pages){
+  if (mem == NULL) return;
+  mem->stats.resident += pages;
+  if (mem->stats.resident > mem->stats.peak) mem->stats.peak = mem->stats.resident;
+}
+
+/* alloc_page_dir
+ *   DESCRIPTION: gives an address space its own page directory: the kernel
+ *                entries are copied from the kernel's directory (they never
+ *                change after boot), the user page and heap entries point
+ *                at the process's page tables
+ *   INPUT: mem - address space with its page tables set
+ *	 OUTPUT: 0 on success, -1 if the frame pool ran out
+ */
+static int32_t alloc_page_dir(user_mem_t* mem){
+  PDE_t* dir = (PDE_t*)alloc_user_frame();
+
+  if (dir == NULL) return -1;
+  memcpy(dir, Page_Directory_Entry, FRAME_SIZE);
+  dir[USER_VIRTUAL_ADDR].val = (uint32_t)mem->page_table | USER_BIT | READ_WRITE_BIT | PRESENT_BIT;
+  mem->page_dir = dir;
+  set_heap_directory(mem);
+  return 0;
+}
 
-  /* 32 reprsents 128MB in the RAM */
-  Page_Directory_Entry[USER_VIRTUAL_ADDR].present = 1; // make a page
-  Page_Directory_Entry[USER_VIRTUAL_ADDR].read_write = 1; // the page is read/write
-  Page_Directory_Entry[USER_VIRTUAL_ADDR].user_supervisor = 1; //can be accessed by the user program
-  Page_Directory_Entry[USER_VIRTUAL_ADDR].page_size = 1; // 4MB size page without page table
+/* alloc_process_memory
+ *   DESCRIPTION: gives a new process a page directory and an empty page
+ *                table for its 4MB user page. Pages are mapped as they are
+ *                first touched (see handle_demand_fault), so a process only
+ *                holds the frames of the code, data and stack it actually uses.
+ *   INPUT: mem - address space of the new process
+ *	 OUTPUT: 0 on success, -1 if the frame pool ran out
+ *	 SIDE EFFECTS: takes two frames (directory and table) from the pool
+ */
+int32_t alloc_process_memory(user_mem_t* mem){
+  int i;
+  PTE_t* table = (PTE_t*)alloc_zeroed_frame();
+
+  if (table == NULL) return -1;
+
+  mem->page_table = table;
+  for (i = 0; i < USER_HEAP_PDE_NUM; i++) mem->heap_table[i] = NULL;
+  memset(&mem->stats, 0, sizeof(mem_stats_t));
+  if (alloc_page_dir(mem) == -1){
+    put_user_frame((uint32_t)table);
+    mem->page_table = NULL;
+    return -1;
+  }
+  return 0;
+}
 
-  Page_Directory_Entry[USER_VIRTUAL_ADDR].page_table_addr = (USER_SPACE_OFFSET >> ALIGN) + PID*(USER_SPACE_SIZE >> ALIGN); // 4KB aligned (right shift by 4 kB)
+/* share_page_table
+ *   DESCRIPTION: copies a user page table for fork. Writable pages become
+ *                read-only copy-on-write on both sides; shared memory
+ *                segments stay writable and shared, pages out in swap
+ *                share the slot.
+ *   INPUT: table - page table of the parent
+ *	 OUTPUT: the child's copy, NULL if the frame pool ran out
+ *	 SIDE EFFECTS: write-protects the parent's pages (caller flushes the TLB)
+ */
+static PTE_t* share_page_table(PTE_t* table){
+  int i;
+  PTE_t* copy = (PTE_t*)alloc_user_frame();
+
+  if (copy == NULL) return NULL;
+
+  for (i = 0; i < NUM_PTE; i++){
+    if (table[i].present){
+      if (table[i].read_write && !(table[i].val & PTE_SHM_BIT)){
+        table[i].read_write = 0;
+        table[i].val |= PTE_COW_BIT;
+      }
+      get_user_frame(table[i].val & FRAME_MASK);
+    }
+    else if (table[i].val & PTE_SWAP_BIT) swap_dup(table[i].val >> ALIGN);
+    copy[i] = table[i];
+  }
+  return copy;
+}
+
+/* fork_process_memory
+ *   DESCRIPTION: gives the child page tables that share every page of the
+ *                parent (user page and heap), so nothing is copied until
+ *                somebody writes
+ *   INPUT: parent - address space being forked (must be the current one)
+ *          child - address space of the new child
+ *	 OUTPUT: 0 on success, -1 if the frame pool ran out
+ *	 SIDE EFFECTS: write-protects the parent's pages and flushes the TLB (all
+ *                 but the global kernel entries)
+ */
+int32_t fork_process_memory(user_mem_t* parent, user_mem_t* child){
+  int i;
+
+  child->page_dir = NULL;
+  // the child starts out sharing every page the parent has
+  memset(&child->stats, 0, sizeof(mem_stats_t));
+  child->stats.resident = parent->stats.resident;
+  child->stats.peak = parent->stats.resident;
+  child->page_table = share_page_table(parent->page_table);
+  if (child->page_table == NULL) return -1;
+
+  for (i = 0; i < USER_HEAP_PDE_NUM; i++) child->heap_table[i] = NULL;
+  for (i = 0; i < USER_HEAP_PDE_NUM; i++){
+    if (parent->heap_table[i] == NULL) continue;
+    child->heap_table[i] = share_page_table(parent->heap_table[i]);
+    if (child->heap_table[i] == NULL){
+      free_process_memory(child);
+      return -1;
+    }
+  }
+  if (alloc_page_dir(child) == -1){
+    free_process_memory(child);
+    return -1;
+  }
 
-  /* flush TLB */
+  /* flush TLB; the parent's pages just became read-only */
   asm volatile(
                 "movl %0, %%eax;"
                 "movl %%eax, %%cr3;"
                 :                      /* no outputs */
-                :"r"(Page_Directory_Entry)    /* input */
+                :"r"(cur_page_dir)    /* input */
                 :"%eax"                /* clobbered register */
   );
+  return 0;
 }
 
-/* free_process_memory
- *   DESCRIPTION: gets rid of the extended page of selected process
- *   INPUT: PID - process ID number to close
+/* user_pte
+ *   DESCRIPTION: finds the page table entry of the current process mapping
+ *                a user virtual address
+ *   INPUT: addr - virtual address
+ *	 OUTPUT: the entry, NULL if addr is not in the user page or the heap
+ */
+static PTE_t* user_pte(uint32_t addr){
+  uint32_t dir_ent = (addr >> DENTRY_SHIFT_OFFSET) & MASK_D_P;
+  uint32_t page_ent = (addr >> ALIGN) & MASK_D_P;
+
+  if ((dir_ent != USER_VIRTUAL_ADDR &&
+       (dir_ent < USER_HEAP_PDE_START || dir_ent >= USER_HEAP_PDE_START + USER_HEAP_PDE_NUM)) ||
+      !cur_page_dir[dir_ent].present || cur_page_dir[dir_ent].page_size)
+    return NULL;
+
+  return (PTE_t*)(cur_page_dir[dir_ent].page_table_addr << ALIGN) + page_ent;
+}
+
+/* clock_table
+ *   DESCRIPTION: page table of an address space a page of the reclaim clock
+ *                is in
+ *   INPUT: mem - the address space
+ *          page - 0 ~ CLOCK_PAGES - 1
+ *	 OUTPUT: the table, NULL if there is none
+ */
+static PTE_t* clock_table(user_mem_t* mem, uint32_t page){
+  uint32_t t = page >> (DENTRY_SHIFT_OFFSET - ALIGN);
+  return t == 0 ? mem->page_table : mem->heap_table[t - 1];
+}
+
+/* clock_addr
+ *   DESCRIPTION: virtual address of a page of the reclaim clock
+ *   INPUT: page - 0 ~ CLOCK_PAGES - 1
+ *	 OUTPUT: the address
+ */
+static uint32_t clock_addr(uint32_t page){
+  uint32_t t = page >> (DENTRY_SHIFT_OFFSET - ALIGN);
+  uint32_t base = t == 0 ? VIRTUAL_ADDR_START : USER_HEAP_START + ((t - 1) << DENTRY_SHIFT_OFFSET);
+  return base + ((page & MASK_D_P) << ALIGN);
+}
+
+/* next_leader
+ *   DESCRIPTION: steps the reclaim clock to the next address space, i.e.
+ *                the next process in process_list that isn't a thread of
+ *                another one, wrapping around
+ *   INPUT: pcb - where the clock is, NULL to start at the front
+ *	 OUTPUT: the process, NULL if there are none
+ */
+static pcb_t* next_leader(pcb_t* pcb){
+  pcb_t* p;
+
+  for (p = (pcb == NULL) ? process_list : pcb->next_proc; p != NULL; p = p->next_proc){
+    if (p->leader == p) return p;
+  }
+  for (p = process_list; p != NULL && pcb != NULL; p = p->next_proc){
+    if (p->leader == p) return p;
+    if (p == pcb) break;
+  }
+  return NULL;
+}
+
+/* find_leader
+ *   DESCRIPTION: finds the address space a clock hand was left at
+ *   INPUT: pid - pid of its process
+ *	 OUTPUT: the process, NULL if it is gone
+ */
+static pcb_t* find_leader(uint32_t pid){
+  pcb_t* pcb;
+
+  for (pcb = process_list; pcb != NULL; pcb = pcb->next_proc){
+    if (pcb->leader == pcb && pcb->pid == pid) return pcb;
+  }
+  return NULL;
+}
+
+/* swap_out_page
+ *   DESCRIPTION: writes a private page out to swap and frees its frame. A
+ *                page read back from swap and not dirtied since still has
+ *                its copy there and isn't written again.
+ *   INPUT: mem - address space the page is in
+ *          pte - its entry, present, frame referenced only by it
+ *          addr - its virtual address
+ *	 OUTPUT: 0 on success, -1 if swap is off, full or failing
+ *	 SIDE EFFECTS: the entry holds the slot instead; drops its TLB entry
+ */
+static int32_t swap_out_page(user_mem_t* mem, PTE_t* pte, uint32_t addr){
+  uint32_t frame = pte->val & FRAME_MASK;
+  uint32_t idx = (frame - USER_FRAME_POOL_START) >> ALIGN;
+  int32_t slot = (int32_t)frame_swap_slot[idx] - 1;
+
+  if (slot == -1){
+    slot = swap_alloc();
+    if (slot == -1) return -1;
+    if (swap_write(slot, frame) == -1){
+      swap_free(slot);
+      return -1;
+    }
+  }
+  else if (pte->dirty && swap_write(slot, frame) == -1) return -1;
+
+  frame_swap_slot[idx] = 0; // the frame's reference on the slot goes to the entry
+  pte->val = ((uint32_t)slot << ALIGN) | PTE_SWAP_BIT;
+  if (mem == cur_mem) invlpg(addr);
+  put_user_frame(frame);
+  add_resident(mem, -1);
+  return 0;
+}
+
+/* reclaim_frame
+ *   DESCRIPTION: frees a frame when the pool ran dry by paging something out
+ *                (second chance clock). The hand goes around the user pages
+ *                of every address space; a page whose accessed bit is set
+ *                gets the bit cleared and is passed over, one still clear on
+ *                the next pass goes out to swap. Only private pages go out:
+ *                shared memory, the zero page and frames shared
+ *                copy-on-write stay.
+ *   INPUT: none (called with interrupts off)
+ *	 OUTPUT: 0 if a frame was freed, -1 if there is nothing to page out or
+ *           swap is off or full
+ *	 SIDE EFFECTS: clears accessed bits; the page that goes out faults back
+ *                 in later (see handle_demand_fault)
+ */
+static int32_t reclaim_frame(void){
+  pcb_t* pcb;
+  PTE_t* table;
+  PTE_t* pte;
+  uint32_t frame, scanned, limit;
+
+  limit = 0;
+  for (pcb = process_list; pcb != NULL; pcb = pcb->next_proc){
+    if (pcb->leader == pcb) limit += 2 * CLOCK_PAGES; // twice around at most
+  }
+
+  pcb = find_leader(clock_pid);
+  if (pcb == NULL){
+    pcb = next_leader(NULL);
+    clock_page = 0;
+    if (pcb != NULL) clock_pid = pcb->pid;
+  }
+
+  for (scanned = 0; pcb != NULL && scanned < limit; ){
+    for (; clock_page < CLOCK_PAGES && scanned < limit; clock_page++, scanned++){
+      table = clock_table(&pcb->mem, clock_page);
+      if (table == NULL){
+        // skip the rest of the table
+        scanned += MASK_D_P - (clock_page & MASK_D_P);
+        clock_page |= MASK_D_P;
+        continue;
+      }
+      pte = &table[clock_page & MASK_D_P];
+      if (!pte->present || (pte->val & PTE_SHM_BIT)) continue;
+      frame = pte->val & FRAME_MASK;
+      if (frame == zero_frame || user_frame_ref[(frame - USER_FRAME_POOL_START) >> ALIGN] != 1) continue;
+
+      if (pte->accessed){
+        // second chance; the cpu sets the bit again on the next use
+        pte->accessed = 0;
+        if (&pcb->mem == cur_mem) invlpg(clock_addr(clock_page));
+        continue;
+      }
+      if (swap_out_page(&pcb->mem, pte, clock_addr(clock_page)) == -1) return -1;
+      clock_page++;
+      return 0;
+    }
+    if (clock_page >= CLOCK_PAGES){
+      pcb = next_leader(pcb);
+      clock_page = 0;
+      if (pcb != NULL) clock_pid = pcb->pid;
+    }
+  }
+  return -1;
+}
+
+/* alloc_page_frame
+ *   DESCRIPTION: frame for a user page being faulted in; if the pool ran dry,
+ *                pages are reclaimed to swap until one is free
+ *   INPUT: zeroed - nonzero for a zeroed frame
+ *	 OUTPUT: physical address of the frame, 0 if there is none even so
+ *	 SIDE EFFECTS: frame's reference count becomes 1
+ */
+static uint32_t alloc_page_frame(int zeroed){
+  uint32_t frame;
+
+  do {
+    frame = zeroed ? alloc_zeroed_frame() : alloc_user_frame();
+  } while (frame == 0 && reclaim_frame() == 0);
+  return frame;
+}
+
+/* page_csum
+ *   DESCRIPTION: checksum of a frame's contents, for same-page merging
+ *   INPUT: frame_addr - physical address of the frame
+ *	 OUTPUT: the checksum
+ */
+static uint32_t page_csum(uint32_t frame_addr){
+  uint32_t* word = (uint32_t*)frame_addr;
+  uint32_t csum = 5381;
+  uint32_t i;
+
+  for (i = 0; i < FRAME_SIZE / sizeof(uint32_t); i++) csum = (csum << 5) + csum + word[i];
+  return csum;
+}
+
+/* same_page
+ *   DESCRIPTION: compares the contents of two frames
+ *   INPUT: a, b - physical addresses of the frames
+ *	 OUTPUT: 1 if they are the same, 0 if not
+ */
+static int same_page(uint32_t a, uint32_t b){
+  uint32_t i;
+
+  for (i = 0; i < FRAME_SIZE / sizeof(uint32_t); i++){
+    if (((uint32_t*)a)[i] != ((uint32_t*)b)[i]) return 0;
+  }
+  return 1;
+}
+
+/* merge_page
+ *   DESCRIPTION: looks at a private page for same-page merging. Its
+ *                checksum has to be the same as at the last look (pages
+ *                still being written aren't worth it). Then it is mapped to
+ *                the zero page or a frame with the same contents found
+ *                through the hash, copy-on-write, and its own frame is
+ *                freed. If there is none it becomes one: write-protected
+ *                and hashed, so later pages can merge with it.
+ *   INPUT: mem - address space the page is in
+ *          pte - its entry, present
+ *          addr - its virtual address
  *	 OUTPUT: none
- *	 SIDE EFFECTS: disables paging in the memory space in user space depending on the PID
+ *	 SIDE EFFECTS: may remap or write-protect the page and drop its TLB entry
+ */
+static void merge_page(user_mem_t* mem, PTE_t* pte, uint32_t addr){
+  uint32_t frame = pte->val & FRAME_MASK;
+  uint32_t idx = (frame - USER_FRAME_POOL_START) >> ALIGN;
+  uint32_t csum, other, other_idx, dirty;
+
+  // a read-only page that isn't copy-on-write must stay so
+  if ((pte->val & PTE_SHM_BIT) || frame == zero_frame ||
+      (!pte->read_write && !(pte->val & PTE_COW_BIT)) ||
+      user_frame_ref[idx] != 1 || (frame_mergeable[idx >> 5] & (1 << (idx & 31))))
+    return;
+
+  csum = page_csum(frame);
+  if (csum != frame_csum[idx]){
+    frame_csum[idx] = csum;
+    return;
+  }
+
+  if (csum == zero_csum && same_page(frame, zero_frame)){
+    other = zero_frame;
+  }
+  else {
+    other = merge_table[csum & (MERGE_TABLE_SIZE - 1)];
+    other_idx = (other - USER_FRAME_POOL_START) >> ALIGN;
+    if (other == 0 || other == frame || !(frame_mergeable[other_idx >> 5] & (1 << (other_idx & 31))) ||
+        frame_csum[other_idx] != csum || !same_page(frame, other)){
+      // first of its kind so far
+      pte->val = (pte->val & ~READ_WRITE_BIT) | PTE_COW_BIT;
+      if (mem == cur_mem) invlpg(addr);
+      frame_mergeable[idx >> 5] |= 1 << (idx & 31);
+      merge_table[csum & (MERGE_TABLE_SIZE - 1)] = frame;
+      return;
+    }
+    get_user_frame(other);
+    drop_swap_copy(other);
+  }
+
+  // the contents may exist only in memory; page-out must know to write them
+  dirty = pte->dirty;
+  pte->val = other | PTE_COW_BIT | USER_BIT | PRESENT_BIT;
+  pte->dirty = dirty;
+  if (mem == cur_mem) invlpg(addr);
+  put_user_frame(frame);
+  if (other == zero_frame) add_resident(mem, -1);
+  mem->stats.merged++;
+}
+
+/* merge_idle_pages
+ *   DESCRIPTION: same-page merging, a few pages at a time for the idle
+ *                loop. A pass goes over the user pages of every address
+ *                space (see merge_page); passes start MERGE_PASS_TICKS apart.
+ *   INPUT: none (called with interrupts off)
+ *	 OUTPUT: 1 if there is more to do in this pass, 0 if the pass is over
+ *           or it isn't time for the next one
+ *	 SIDE EFFECTS: frees the frames of merged pages
+ */
+int32_t merge_idle_pages(void){
+  pcb_t* pcb;
+  PTE_t* table;
+  uint32_t n;
+
+  if (zero_frame == 0) return 0;
+  if (!merge_active){
+    if ((int32_t)(pit_ticks - merge_next_pass) < 0) return 0;
+    pcb = next_leader(NULL);
+    if (pcb == NULL) return 0;
+    merge_active = 1;
+    merge_hand_pid = pcb->pid;
+    merge_hand_page = 0;
+  }
+
+  pcb = find_leader(merge_hand_pid);
+  for (n = 0; n < MERGE_BATCH && pcb != NULL; ){
+    if (merge_hand_page >= CLOCK_PAGES){
+      // next address space, no wrapping around: that ends the pass
+      for (pcb = pcb->next_proc; pcb != NULL && pcb->leader != pcb; pcb = pcb->next_proc);
+      if (pcb != NULL) merge_hand_pid = pcb->pid;
+      merge_hand_page = 0;
+      continue;
+    }
+    table = clock_table(&pcb->mem, merge_hand_page);
+    if (table == NULL){
+      merge_hand_page = (merge_hand_page | MASK_D_P) + 1;
+      continue;
+    }
+    if (table[merge_hand_page & MASK_D_P].present){
+      merge_page(&pcb->mem, &table[merge_hand_page & MASK_D_P], clock_addr(merge_hand_page));
+      n++;
+    }
+    merge_hand_page++;
+  }
+
+  if (pcb == NULL){
+    merge_active = 0;
+    merge_next_pass = pit_ticks + MERGE_PASS_TICKS;
+    return 0;
+  }
+  return 1;
+}
+
+/* handle_cow_fault
+ *   DESCRIPTION: resolves a write fault on a copy-on-write user page. The last
+ *                process holding the frame gets it back writable; otherwise the
+ *                page is copied into a fresh frame.
+ *   INPUT: fault_addr - faulting virtual address (cr2)
+ *	 OUTPUT: 0 if the fault was resolved, -1 if it is not a copy-on-write fault
+ *	 SIDE EFFECTS: remaps the faulting page and drops its TLB entry
+ */
+int32_t handle_cow_fault(uint32_t fault_addr){
+  uint32_t old_frame, new_frame, idx;
+  PTE_t* pte = user_pte(fault_addr);
+
+  if (pte == NULL || !pte->present || !(pte->val & PTE_COW_BIT)) return -1;
+
+  old_frame = pte->val & FRAME_MASK;
+  if (old_frame == zero_frame){
+    /* first write to untouched memory */
+    new_frame = alloc_page_frame(1);
+    if (new_frame == 0) return -1;
+    pte->val = new_frame | USER_BIT | READ_WRITE_BIT | PRESENT_BIT;
+    add_resident(cur_mem, 1);
+  }
+  else if (user_frame_ref[(old_frame - USER_FRAME_POOL_START) >> ALIGN] == 1){
+    /* nobody else shares it anymore; just take it back (and it can't be
+     * merged with anymore, it is about to change) */
+    pte->val = (pte->val & ~PTE_COW_BIT) | READ_WRITE_BIT;
+    idx = (old_frame - USER_FRAME_POOL_START) >> ALIGN;
+    frame_mergeable[idx >> 5] &= ~(1 << (idx & 31));
+  }
+  else {
+    new_frame = alloc_page_frame(0);
+    if (new_frame == 0) return -1;
+    memcpy((void*)new_frame, (void*)old_frame, FRAME_SIZE);
+    put_user_frame(old_frame);
+    pte->val = new_frame | USER_BIT | READ_WRITE_BIT | PRESENT_BIT;
+  }
+  if (cur_mem != NULL){
+    cur_mem->stats.minor_faults++;
+    cur_mem->stats.cow_breaks++;
+  }
+
+  invlpg(fault_addr);
+  return 0;
+}
+
+/* user_addr_mappable
+ *   DESCRIPTION: checks that a page may be mapped at a user address at all:
+ *                anywhere in the 128MB user page but the guard page under
+ *                the stack, and in the heap anything below the break. Every
+ *                path that maps user pages (faults, pipe page flips, shared
+ *                memory) goes through this.
+ *   INPUT: pcb - leader of the process
+ *          addr - user virtual address
+ *	 OUTPUT: 1 if so, 0 if not
+ */
+static int32_t user_addr_mappable(pcb_t* pcb, uint32_t addr){
+  if ((addr >> DENTRY_SHIFT_OFFSET) == USER_VIRTUAL_ADDR){
+    // the stack grew past its limit
+    return !(addr < USER_STACK_TOP - pcb->stack_limit &&
+             addr >= USER_STACK_TOP - pcb->stack_limit - FRAME_SIZE);
+  }
+  return addr >= USER_HEAP_START && addr < pcb->heap_end;
+}
+
+/* mem_owner
+ *   DESCRIPTION: finds the process an address space belongs to; every
+ *                user_mem_t is the mem of a leader's pcb
+ *   INPUT: mem - address space
+ *	 OUTPUT: pcb of its leader
+ */
+static pcb_t* mem_owner(user_mem_t* mem){
+  return (pcb_t*)((uint8_t*)mem - (uint32_t)&((pcb_t*)0)->mem);
+}
+
+/* handle_demand_fault
+ *   DESCRIPTION: resolves a fault on a user page that isn't mapped. A page
+ *                that went out to swap is read back in. One that was never
+ *                mapped: reading maps the shared zero page copy-on-write, so
+ *                memory that is only read costs no frame; writing gets a
+ *                zeroed frame. Anywhere in the 128MB user page counts but the
+ *                guard page under the stack, and in the heap anything below
+ *                the break. The fault is resolved in the address space cr3 has
+ *                loaded, which while a program is being loaded is the new
+ *                process's rather than the running one's.
+ *   INPUT: fault_addr - faulting virtual address (cr2)
+ *          write - nonzero for a write access
+ *	 OUTPUT: 0 if the fault was resolved, -1 if addr isn't one to map, the
+ *           frame pool ran out or the page couldn't be read back
+ *	 SIDE EFFECTS: maps the page (and maybe a heap page table), drops its
+ *                 TLB entry; may page others out to make room
  */
-void free_process_memory(uint32_t PID){
+int32_t handle_demand_fault(uint32_t fault_addr, uint32_t write){
+  user_mem_t* mem = cur_mem;
+  uint32_t dir_ent = fault_addr >> DENTRY_SHIFT_OFFSET;
+  uint32_t page_ent = (fault_addr >> ALIGN) & MASK_D_P;
+  pcb_t* pcb;
+  PTE_t* table;
+  uint32_t frame, slot;
 
-  /* 32 reprsents 128MB in the RAM */
-  Page_Directory_Entry[USER_VIRTUAL_ADDR].present = 0; // erase a page
-  Page_Directory_Entry[USER_VIRTUAL_ADDR].read_write = 0; // the page is read/write
-  Page_Directory_Entry[USER_VIRTUAL_ADDR].user_supervisor = 0; //can be accessed by the user program
-  Page_Directory_Entry[USER_VIRTUAL_ADDR].page_size = 0; // 4MB size page without page table
+  if (mem == NULL) return -1;
+  pcb = mem_owner(mem);
 
-  Page_Directory_Entry[USER_VIRTUAL_ADDR].page_table_addr = (USER_SPACE_OFFSET >> ALIGN) + PID*(USER_SPACE_SIZE >> ALIGN); // 4KB aligned (right shift by 4 kB)
+  if (!user_addr_mappable(pcb, fault_addr)) return -1;
 
-  /* flush TLB */
+  if (dir_ent == USER_VIRTUAL_ADDR){
+    table = mem->page_table;
+  }
+  else {
+    table = mem->heap_table[dir_ent - USER_HEAP_PDE_START];
+    if (table == NULL){
+      table = (PTE_t*)alloc_page_frame(1);
+      if (table == NULL) return -1;
+      mem->heap_table[dir_ent - USER_HEAP_PDE_START] = table;
+      set_heap_directory(mem);
+    }
+  }
+
+  if (table == NULL || table[page_ent].present) return -1;
+
+  if (table[page_ent].val & PTE_SWAP_BIT){
+    slot = table[page_ent].val >> ALIGN;
+    frame = alloc_page_frame(0);
+    if (frame == 0) return -1;
+    if (swap_read(slot, frame) == -1){
+      put_user_frame(frame);
+      return -1;
+    }
+    // the only copy: keep it, so the page can go out again unwritten
+    if (swap_count(slot) == 1) frame_swap_slot[(frame - USER_FRAME_POOL_START) >> ALIGN] = slot + 1;
+    else swap_free(slot);
+    table[page_ent].val = frame | USER_BIT | READ_WRITE_BIT | PRESENT_BIT;
+    add_resident(mem, 1);
+    mem->stats.major_faults++;
+  }
+  else if (!write && zero_frame != 0){
+    table[page_ent].val = zero_frame | PTE_COW_BIT | USER_BIT | PRESENT_BIT;
+    mem->stats.minor_faults++;
+  }
+  else {
+    frame = alloc_page_frame(1);
+    if (frame == 0) return -1;
+    table[page_ent].val = frame | USER_BIT | READ_WRITE_BIT | PRESENT_BIT;
+    add_resident(mem, 1);
+    mem->stats.minor_faults++;
+  }
+
+  invlpg(fault_addr);
+  return 0;
+}
+
+/* shm_phys_addr
+ *   DESCRIPTION: translates a user address of the current process that is in
+ *                a shared memory segment. Those frames stay put while
+ *                mapped (no copy-on-write, merging or swap), so the result
+ *                names the word for every process that maps it.
+ *   INPUT: addr - user virtual address
+ *	 OUTPUT: physical address, 0 if addr is not in a shared memory page
+ */
+uint32_t shm_phys_addr(uint32_t addr){
+  PTE_t* pte = user_pte(addr);
+
+  if (pte == NULL || !pte->present || !(pte->val & PTE_SHM_BIT)) return 0;
+  return (pte->val & FRAME_MASK) | (addr & ~FRAME_MASK);
+}
+
+/* share_user_page
+ *   DESCRIPTION: takes a reference on the frame behind a page of the current
+ *                process, e.g. to hand it to a pipe. The page becomes
+ *                copy-on-write, so later writes by the process don't show
+ *                through the shared frame.
+ *   INPUT: addr - page aligned user virtual address
+ *	 OUTPUT: physical address of the frame, 0 if addr is not mapped (or is
+ *           shared memory)
+ *	 SIDE EFFECTS: may write-protect the page and drop its TLB entry
+ */
+uint32_t share_user_page(uint32_t addr){
+  PTE_t* pte = user_pte(addr);
+
+  // a shared memory page must stay writable for the other processes
+  if (pte == NULL || !pte->present || (pte->val & PTE_SHM_BIT)) return 0;
+
+  if (pte->read_write){
+    pte->read_write = 0;
+    pte->val |= PTE_COW_BIT;
+
+    invlpg(addr);
+  }
+  get_user_frame(pte->val & FRAME_MASK);
+  drop_swap_copy(pte->val & FRAME_MASK);
+  return pte->val & FRAME_MASK;
+}
+
+/* replace_user_page
+ *   DESCRIPTION: maps a frame at a page of the current process in place of
+ *                what was there, copy-on-write since others may still hold
+ *                the frame. Takes over the caller's reference on the frame.
+ *   INPUT: addr - page aligned user virtual address
+ *          frame_addr - physical address of the frame
+ *	 OUTPUT: 0 on success, -1 if addr has no page table, is shared memory or
+ *           is not one to map (guard page, past the break)
+ *	 SIDE EFFECTS: drops the old frame and the page's TLB entry
+ */
+int32_t replace_user_page(uint32_t addr, uint32_t frame_addr){
+  PTE_t* pte = user_pte(addr);
+  pcb_t* pcb = get_running_pcb();
+
+  if (pte == NULL || (pte->val & PTE_SHM_BIT) || pcb == NULL ||
+      !user_addr_mappable(pcb->leader, addr)) return -1;
+
+  drop_swap_copy(frame_addr);
+  if (pte->present) put_user_frame(pte->val & FRAME_MASK);
+  else if (pte->val & PTE_SWAP_BIT) swap_free(pte->val >> ALIGN);
+  if (!pte->present || (pte->val & FRAME_MASK) == zero_frame) add_resident(cur_mem, 1);
+  pte->val = frame_addr | PTE_COW_BIT | USER_BIT | PRESENT_BIT;
+
+  invlpg(addr);
+  return 0;
+}
+
+/* map_shared_page
+ *   DESCRIPTION: maps a frame of a shared memory segment writable at a page
+ *                of the current process, in place of what was there
+ *   INPUT: addr - page aligned user virtual address
+ *          frame_addr - physical address of the frame
+ *	 OUTPUT: 0 on success, -1 if addr has no page table or is not one to map
+ *           (guard page, past the break)
+ *	 SIDE EFFECTS: takes a reference on the frame for the mapping, drops the
+ *                 old frame and the page's TLB entry
+ */
+int32_t map_shared_page(uint32_t addr, uint32_t frame_addr){
+  PTE_t* pte = user_pte(addr);
+  pcb_t* pcb = get_running_pcb();
+
+  if (pte == NULL || pcb == NULL || !user_addr_mappable(pcb->leader, addr)) return -1;
+
+  get_user_frame(frame_addr);
+  if (pte->present) put_user_frame(pte->val & FRAME_MASK);
+  else if (pte->val & PTE_SWAP_BIT) swap_free(pte->val >> ALIGN);
+  if (!pte->present || (pte->val & FRAME_MASK) == zero_frame) add_resident(cur_mem, 1);
+  pte->val = frame_addr | PTE_SHM_BIT | USER_BIT | READ_WRITE_BIT | PRESENT_BIT;
+
+  invlpg(addr);
+  return 0;
+}
+
+/* set_heap_directory
+ *   DESCRIPTION: points the heap entries of a process's page directory at
+ *                its heap page tables (caller flushes the TLB)
+ *   INPUT: mem - address space of a process
+ *	 OUTPUT: none
+ */
+static void set_heap_directory(user_mem_t* mem){
+  int i;
+  PTE_t* table;
+
+  if (mem->page_dir == NULL) return;
+  for (i = 0; i < USER_HEAP_PDE_NUM; i++){
+    table = mem->heap_table[i];
+    if (table != NULL)
+      mem->page_dir[USER_HEAP_PDE_START + i].val = (uint32_t)table | USER_BIT | READ_WRITE_BIT | PRESENT_BIT;
+    else
+      mem->page_dir[USER_HEAP_PDE_START + i].val = READ_WRITE_BIT;
+  }
+}
+
+/* resize_process_heap
+ *   DESCRIPTION: moves the heap break of the current process. Growing maps
+ *                nothing; pages below the break are mapped (zeroed) when
+ *                first touched. Shrinking unmaps the pages past the new break
+ *                and drops their swap slots.
+ *   INPUT: mem - address space of the current process
+ *          old_end - current break
+ *          new_end - wanted break, USER_HEAP_START ~ USER_HEAP_END
+ *	 OUTPUT: 0
+ *	 SIDE EFFECTS: drops the TLB entries of the unmapped pages
+ */
+int32_t resize_process_heap(user_mem_t* mem, uint32_t old_end, uint32_t new_end){
+  uint32_t old_top = (old_end + FRAME_SIZE - 1) & FRAME_MASK;
+  uint32_t new_top = (new_end + FRAME_SIZE - 1) & FRAME_MASK;
+  uint32_t addr, page_ent;
+  PTE_t* table;
+
+  /* shrink */
+  for (addr = new_top; addr < old_top; addr += FRAME_SIZE){
+    table = mem->heap_table[(addr >> DENTRY_SHIFT_OFFSET) - USER_HEAP_PDE_START];
+    page_ent = (addr >> ALIGN) & MASK_D_P;
+    if (table == NULL) continue;
+    if (!table[page_ent].present){
+      if (table[page_ent].val & PTE_SWAP_BIT) swap_free(table[page_ent].val >> ALIGN);
+      table[page_ent].val = 0;
+      continue;
+    }
+    if ((table[page_ent].val & FRAME_MASK) != zero_frame) add_resident(mem, -1);
+    put_user_frame(table[page_ent].val & FRAME_MASK);
+    table[page_ent].val = 0;
+    invlpg(addr);
+  }
+  return 0;
+}
+
+/* set_process_memory
+ *   DESCRIPTION: switches to the page directory of a process; nothing shared
+ *                is written, it is a single cr3 load
+ *   INPUT: mem - address space to switch to
+ *	 OUTPUT: none
+ *	 SIDE EFFECTS: enables paging in the memory space in user space of that process
+ */
+void set_process_memory(user_mem_t* mem){
+  cur_page_dir = mem->page_dir;
+  cur_mem = mem;
+
+  /* load cr3 (flushes the TLB) */
   asm volatile(
                 "movl %0, %%eax;"
                 "movl %%eax, %%cr3;"
                 :                      /* no outputs */
-                :"r"(Page_Directory_Entry)    /* input */
+                :"r"(cur_page_dir)    /* input */
                 :"%eax"                /* clobbered register */
   );
 }
 
+/* free_process_memory
+ *   DESCRIPTION: gets rid of the address space of selected process,
+ *                returning its frames, page tables and page directory to the
+ *                pool. If it is the one loaded, the kernel's own directory is
+ *                loaded first.
+ *   INPUT: mem - address space to free
+ *	 OUTPUT: none
+ *	 SIDE EFFECTS: may load the kernel's page directory
+ */
+void free_process_memory(user_mem_t* mem){
+  int i;
+
+  if (mem->page_dir != NULL && mem->page_dir == cur_page_dir){
+    cur_page_dir = Page_Directory_Entry;
+    cur_mem = NULL;
+    asm volatile(
+                  "movl %0, %%eax;"
+                  "movl %%eax, %%cr3;"
+                  :                      /* no outputs */
+                  :"r"(cur_page_dir)    /* input */
+                  :"%eax"                /* clobbered register */
+    );
+  }
+
+  if (mem->page_table != NULL){
+    release_page_table(mem->page_table);
+    mem->page_table = NULL;
+  }
+
+  for (i = 0; i < USER_HEAP_PDE_NUM; i++){
+    if (mem->heap_table[i] != NULL){
+      release_page_table(mem->heap_table[i]);
+      mem->heap_table[i] = NULL;
+    }
+  }
+
+  if (mem->page_dir != NULL){
+    put_user_frame((uint32_t)mem->page_dir);
+    mem->page_dir = NULL;
+  }
+  mem->stats.resident = 0;
+}
+
 
 /* set_up_virtual_to_video 
  *   DESCRIPTION: maps the terminal video virtual addr to correct video buffer / video memory
@@ -138,27 +1293,40 @@ void set_up_virtual_to_video(uint8_t tid){
 
   //Set up the corresponding virtual address's page table to video memory 4kb
   int page_ent = ((uint32_t)v_addr_to_video >> ALIGN) & MASK_D_P;
-  Page_Table_Entry_For_Video[page_ent].val = (VID_MEM_OFFSET * ADDR_START_OFFSET) | READ_WRITE_BIT | PRESENT_BIT;
+  Page_Table_Entry_For_Video[page_ent].val = (VID_MEM_OFFSET * ADDR_START_OFFSET) | video_mem_type | GLOBAL_BIT | READ_WRITE_BIT | PRESENT_BIT;
   Page_Table_Entry_For_Video[page_ent].user_supervisor = 1;
 
   //Set up the corresponding virtual address's page table to video buf 1 (4kb)
   int page_ent_1 = ((uint32_t)v_addr_to_buf_1 >> ALIGN) & MASK_D_P;
-  Page_Table_Entry_For_Video[page_ent_1].val = (VID_BUF_ADDR_BASE + buf_1_tid * ADDR_START_OFFSET) | READ_WRITE_BIT | PRESENT_BIT;
+  Page_Table_Entry_For_Video[page_ent_1].val = vid_buf_frame[buf_1_tid] | GLOBAL_BIT | READ_WRITE_BIT | PRESENT_BIT;
   Page_Table_Entry_For_Video[page_ent_1].user_supervisor = 1;
 
   //Set up the corresponding virtual address's page table to video buf 2 (4kb)
   int page_ent_2 = ((uint32_t)v_addr_to_buf_2 >> ALIGN) & MASK_D_P;
-  Page_Table_Entry_For_Video[page_ent_2].val =  (VID_BUF_ADDR_BASE + buf_2_tid * ADDR_START_OFFSET) | READ_WRITE_BIT | PRESENT_BIT;
+  Page_Table_Entry_For_Video[page_ent_2].val = vid_buf_frame[buf_2_tid] | GLOBAL_BIT | READ_WRITE_BIT | PRESENT_BIT;
   Page_Table_Entry_For_Video[page_ent_2].user_supervisor = 1;
 
 	// Set up corresponding directory entry map to Page_Table_Entry_For_Video
   Page_Directory_Entry[dir_ent].page_table_addr = ((unsigned int)Page_Table_Entry_For_Video >> ALIGN);
 
-  asm volatile(
-                "movl %0, %%eax;"
-                "movl %%eax, %%cr3;"
-                :                      /* no outputs */
-                :"r"(Page_Directory_Entry)    /* input */
-                :"%eax"                /* clobbered register */
-  );
+  // the entries are global (every process maps video the same), so a cr3
+  // load wouldn't drop them
+  invlpg(v_addr_to_video);
+  invlpg(v_addr_to_buf_1);
+  invlpg(v_addr_to_buf_2);
+}
+
+/* bad_userspace_addr
+ *   DESCRIPTION: checks that a buffer lies in the user part of the address
+ *                space (the program page up to the end of the heap area).
+ *                Whether its pages are mapped is left to the copy routines.
+ *   INPUT: addr - start of the buffer
+ *          len - its size in bytes
+ *	 OUTPUT: 1 if it doesn't, 0 if it does
+ */
+int32_t bad_userspace_addr(const void* addr, int32_t len){
+  uint32_t start = (uint32_t)addr;
+
+  if (len < 0 || start < VIRTUAL_ADDR_START || start > USER_HEAP_END) return 1;
+  return (uint32_t)len > USER_HEAP_END - start;
 }
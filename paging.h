@@ -12,14 +12,104 @@
 #define USER_SPACE_SIZE     0x400000
 #define READ_WRITE_BIT 		0x00000002
 #define PRESENT_BIT 			0x00000001
+#define USER_BIT 					0x00000004
+#define PAGE_SIZE_BIT 		0x00000080
+#define GLOBAL_BIT 				0x00000100 // kept in the TLB across cr3 loads (CR4.PGE)
+#define PTE_COW_BIT 			0x00000200 // avail bit 0: page is shared copy-on-write
+#define PTE_PAT_BIT 			0x00000080 // with PCD and PWT clear: PAT entry 4 (write-combining)
+#define PTE_SHM_BIT 			0x00000400 // avail bit 1: page of a shared memory segment
+#define PTE_SWAP_BIT 			0x00000800 // avail bit 2, not present: page is in the swap
+                                       // slot held in the address bits
+#define FRAME_SIZE 				0x1000
+#define FRAME_MASK 				0xFFFFF000
 #define ADDR_START_OFFSET		  0x1000
 #define USER_VIRTUAL_ADDR 				32 // 4MB * 32 = 128 MB
 #define DENTRY_SHIFT_OFFSET				22
 
 #define MASK_D_P 					0x000003FF
 
-/* memory location for video buf, in phys addr space(cp5) */
-#define VID_BUF_ADDR_BASE 				 (0x800000 + 0x400000*6)
+/* user pages are handed out 4KB at a time from the RAM above the kernel, as
+ * far as the boot loader's memory map goes (up to 128MB, where user space
+ * starts); the kernel keeps this range mapped 1:1 (supervisor only) to copy
+ * frames */
+#define USER_FRAME_POOL_START 		USER_SPACE_OFFSET
+#define USER_FRAME_POOL_END 			(USER_VIRTUAL_ADDR << DENTRY_SHIFT_OFFSET)
+#define USER_FRAME_NUM 						((USER_FRAME_POOL_END - USER_FRAME_POOL_START) >> ALIGN)
+#define USER_FRAME_POOL_FALLBACK_END 0x2000000 // 32MB, without a memory map
+#define FRAME_RESERVED 						0xFFFF // reference count of a frame that isn't RAM
+#define LARGE_FRAME_FRAMES 				NUM_PTE // 4KB frames in a 4MB frame
+#define ZERO_POOL_SIZE 						64 // frames the idle loop keeps zeroed
+
+/* multiboot info flags and memory map types used by init_frame_pool */
+#define MULTIBOOT_INFO_MEM 				0x00000001
+#define MULTIBOOT_INFO_MODS 			0x00000008
+#define MULTIBOOT_INFO_MMAP 			0x00000040
+#define MMAP_TYPE_RAM 						1
+
+/* user heap (brk/sbrk): 4KB pages from the frame pool, past the video page */
+#define USER_HEAP_PDE_START 			34 // 4MB * 34 = 136 MB
+#define USER_HEAP_PDE_NUM 				4  // up to 16MB of heap
+#define USER_HEAP_START 					(USER_HEAP_PDE_START << DENTRY_SHIFT_OFFSET)
+#define USER_HEAP_END 						((USER_HEAP_PDE_START + USER_HEAP_PDE_NUM) << DENTRY_SHIFT_OFFSET)
+
+/* user stack: grows down from the top of the user page as it faults, up to
+ * the process's stack_limit; the page below that is a guard that is never
+ * mapped, so running off the stack is a SIG_SEGFAULT */
+#define USER_STACK_TOP 						((USER_VIRTUAL_ADDR + 1) << DENTRY_SHIFT_OFFSET)
+#define USER_STACK_DEFAULT_LIMIT 	0x100000 // 1MB
+
+/* pages of one address space the reclaim clock goes around: the user page,
+ * then the heap */
+#define CLOCK_PAGES 							((1 + USER_HEAP_PDE_NUM) * NUM_PTE)
+
+/* same-page merging, done by the idle loop: pages whose contents stayed the
+ * same between two looks are hashed, identical ones share one frame */
+#define MERGE_TABLE_SIZE 					1024 // hash buckets, a power of two
+#define MERGE_BATCH 							8    // pages looked at per call
+#define MERGE_PASS_TICKS 					20   // pit ticks between passes (1s)
+
+/* kernel stacks (8KB, pcb at the bottom) come from the pool as well */
+#define KERNEL_STACK_FRAMES 			2
+
+/* page attribute table: entry 4 (PTE_PAT_BIT) is made write-combining for
+ * VGA memory; entries 0-3 keep their defaults so PCD/PWT mean what they did */
+#define CPUID_PAT_BIT 						0x00010000 // cpuid 1, edx
+#define IA32_PAT_MSR 							0x277
+#define PAT_ENTRY_MASK 						0xFF
+#define PAT_TYPE_WC 							0x01
+
+/* page fault error code bits */
+#define PF_PRESENT_BIT 						0x1
+#define PF_WRITE_BIT 							0x2
+#define PF_USER_BIT 							0x4
+
+/* reads and writes a model specific register, as a high and a low half */
+#define rdmsr(msr, lo, hi)              \
+do {                                    \
+    asm volatile ("rdmsr"               \
+            : "=a"(lo), "=d"(hi)        \
+            : "c"(msr)                  \
+    );                                  \
+} while (0)
+
+#define wrmsr(msr, lo, hi)              \
+do {                                    \
+    asm volatile ("wrmsr"               \
+            :                           \
+            : "c"(msr), "a"(lo), "d"(hi) \
+            : "memory"                  \
+    );                                  \
+} while (0)
+
+/* drops the TLB entry of the page holding addr */
+#define invlpg(addr)                    \
+do {                                    \
+    asm volatile ("invlpg (%0)"         \
+            :                           \
+            : "r"(addr)                 \
+            : "memory"                  \
+    );                                  \
+} while (0)
 
 typedef struct PDE { //a table
     union {
@@ -65,9 +155,54 @@ PTE_t Page_Table_Entry[NUM_PTE] __attribute__ ((aligned(SIZE_OF_ENTRY)));
 
 PTE_t Page_Table_Entry_For_Video[NUM_PTE] __attribute__ ((aligned(SIZE_OF_ENTRY)));
 
+/* memory use of one address space; read with the memstat system call */
+typedef struct mem_stats_t{
+    uint32_t resident;      // pages mapped to a frame (the zero page doesn't count)
+    uint32_t peak;          // most pages resident at once
+    uint32_t minor_faults;  // faults resolved without I/O
+    uint32_t major_faults;  // faults that had to read the page in
+    uint32_t cow_breaks;    // writes that made a copy-on-write page private
+    uint32_t merged;        // pages merged with an identical one (or the zero page)
+}mem_stats_t;
+
+/* page directory and tables of one process's address space */
+typedef struct user_mem_t{
+    PDE_t* page_dir;                       // kernel entries shared, loaded into cr3
+    PTE_t* page_table;                     // backs the 128MB user page
+    PTE_t* heap_table[USER_HEAP_PDE_NUM];  // NULL until the break reaches them
+    mem_stats_t stats;
+}user_mem_t;
+
 extern void init_paging();
-void set_process_memory(uint32_t PID);
-void free_process_memory(uint32_t PID);
+int32_t alloc_process_memory(user_mem_t* mem);
+int32_t fork_process_memory(user_mem_t* parent, user_mem_t* child);
+void set_process_memory(user_mem_t* mem);
+void free_process_memory(user_mem_t* mem);
+int32_t handle_cow_fault(uint32_t fault_addr);
+int32_t handle_demand_fault(uint32_t fault_addr, uint32_t write);
+/* physical address behind a user address in a shared memory segment */
+uint32_t shm_phys_addr(uint32_t addr);
+int32_t resize_process_heap(user_mem_t* mem, uint32_t old_end, uint32_t new_end);
+
+/* 4KB frame pool for user pages, reference counted for copy-on-write */
+struct multiboot_info; // see multiboot.h
+void init_frame_pool(struct multiboot_info* mbi);
+uint32_t alloc_user_frame(void);
+uint32_t alloc_zeroed_frame(void);
+int32_t zero_idle_frame(void);
+int32_t merge_idle_pages(void);
+void get_user_frame(uint32_t frame_addr);
+void put_user_frame(uint32_t frame_addr);
+uint32_t alloc_kernel_stack(void);
+void free_kernel_stack(uint32_t stack_addr);
+uint32_t alloc_large_frame(void);
+void free_large_frame(uint32_t frame_addr);
+uint32_t frames_free(void);
+uint32_t frames_used(void);
+/* hand whole user pages around without copying (pipe page flipping) */
+uint32_t share_user_page(uint32_t addr);
+int32_t replace_user_page(uint32_t addr, uint32_t frame_addr);
+int32_t map_shared_page(uint32_t addr, uint32_t frame_addr);
 void set_up_virtual_to_video(uint8_t tid);
 // set new video memory for terminal swapping
 
@@ -0,0 +1,284 @@
+/* pipe.c - kernel pipes between processes
+ * vim:ts=4 noexpandtab
+ */
+
+#include "pipe.h"
+#include "lib.h"
+#include "paging.h"
+#include "sched.h"
+#include "poll.h"
+#include "slab.h"
+
+fops_table pipe_read_ftable = {NULL, (close_t)pipe_close, (read_t)pipe_read, (write_t)pipe_bad_write, (poll_t)pipe_poll};
+fops_table pipe_write_ftable = {NULL, (close_t)pipe_close, (read_t)pipe_bad_read, (write_t)pipe_write, (poll_t)pipe_poll};
+
+/* fd_pipe
+ *   DESCRIPTION: gets the pipe behind a file descriptor of the current process
+ *   INPUT: fd - file descriptor of a pipe end
+ *   OUTPUT: the pipe
+ */
+static pipe_t* fd_pipe(int32_t fd){
+	pcb_t* current_pcb = get_curr_proc();
+	return (pipe_t*)current_pcb->fd_array[fd].data;
+}
+
+/* can_flip
+ *   DESCRIPTION: checks if the next part of a transfer is a whole page,
+ *                so it can be moved by remapping instead of copying
+ *   INPUT: addr - user address the transfer is at
+ *          left - bytes left in the transfer
+ *   OUTPUT: 1 if so, 0 if not
+ */
+static int can_flip(uint32_t addr, uint32_t left){
+	return (addr & ~FRAME_MASK) == 0 && left >= FRAME_SIZE;
+}
+
+/* pipe_create
+ *   DESCRIPTION: makes a new, empty pipe and fills in its two ends
+ *   INPUT: read_end, write_end - file descriptors to fill in
+ *   OUTPUT: 0 on success, -1 if no frame is left for the pipe
+ */
+int32_t pipe_create(fd_t* read_end, fd_t* write_end){
+	pipe_t* p = (pipe_t*)kmalloc(sizeof(pipe_t));
+	if(p == NULL) return -1;
+
+	memset(p, 0, sizeof(pipe_t));
+	p->readers = 1;
+	p->writers = 1;
+
+	read_end->fxn_tbl_ptr = &pipe_read_ftable;
+	read_end->inode = 0;
+	read_end->file_pos = 0;
+	read_end->flags = 1;
+	read_end->data = p;
+
+	*write_end = *read_end;
+	write_end->fxn_tbl_ptr = &pipe_write_ftable;
+	return 0;
+}
+
+/* pipe_dup_fds
+ *   DESCRIPTION: a copy of a file descriptor table was made (fork); counts
+ *                the new pipe ends
+ *   INPUT: pcb - process owning the copy
+ *   OUTPUT: none
+ */
+void pipe_dup_fds(pcb_t* pcb){
+	uint32_t i;
+	pipe_t* p;
+	fd_t* fd_array = pcb->fd_array;
+
+	for(i = 0; i < pcb->fd_count; i++){
+		if(fd_array[i].flags == 0) continue;
+		p = (pipe_t*)fd_array[i].data;
+		if(fd_array[i].fxn_tbl_ptr == &pipe_read_ftable) p->readers++;
+		else if(fd_array[i].fxn_tbl_ptr == &pipe_write_ftable) p->writers++;
+	}
+}
+
+/* pipe_read
+ *   DESCRIPTION: reads what is in the pipe, up to nbytes; blocks while it is
+ *                empty. Whole pages queued by the writer are mapped straight
+ *                into a page aligned buf instead of being copied.
+ *   INPUT: fd - read end
+ *          buf - user buffer
+ *          nbytes - max number of bytes to read
+ *   OUTPUT: number of bytes read, 0 once the pipe is empty and all write
+ *           ends are closed
+ */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes){
+	pipe_t* p = fd_pipe(fd);
+	uint8_t* dst = (uint8_t*)buf;
+	uint32_t done = 0;
+	uint32_t len, frame;
+	uint32_t flags;
+	int fault = 0;
+
+	if(buf == NULL || nbytes < 0) return -1;
+
+	cli_and_save(flags);
+	while(p->count == 0 && p->page_count == 0){
+		if(p->writers == 0){
+			restore_flags(flags);
+			return 0; // end of file
+		}
+		sleep_on(p);
+	}
+
+	/* pages: flip what lines up, copy the rest */
+	while(p->page_count > 0 && done < (uint32_t)nbytes){
+		frame = p->pages[p->page_head];
+		if(p->page_off == 0 && can_flip((uint32_t)(dst + done), nbytes - done) &&
+		   replace_user_page((uint32_t)(dst + done), frame) == 0){
+			len = FRAME_SIZE; // our reference went to the mapping
+		}
+		else{
+			len = FRAME_SIZE - p->page_off;
+			if(len > nbytes - done) len = nbytes - done;
+			if(copy_to_user(dst + done, (uint8_t*)frame + p->page_off, len) != 0){
+				fault = 1;
+				break;
+			}
+			p->page_off += len;
+			if(p->page_off < FRAME_SIZE){
+				done += len;
+				break;
+			}
+			put_user_frame(frame);
+		}
+		done += len;
+		p->page_off = 0;
+		p->page_head = (p->page_head + 1) % PIPE_PAGE_SLOTS;
+		p->page_count--;
+	}
+
+	/* bytes: at most two pieces, around the end of the ring */
+	while(!fault && p->count > 0 && done < (uint32_t)nbytes){
+		len = PIPE_BUF_SIZE - p->head;
+		if(len > p->count) len = p->count;
+		if(len > nbytes - done) len = nbytes - done;
+		if(copy_to_user(dst + done, p->buf + p->head, len) != 0){
+			fault = 1;
+			break;
+		}
+		p->head = (p->head + len) % PIPE_BUF_SIZE;
+		p->count -= len;
+		done += len;
+	}
+
+	wake_up(p); // room for writers
+	restore_flags(flags);
+	if(fault && done == 0) return -1; // buf isn't mapped
+	return done;
+}
+
+/* pipe_write
+ *   DESCRIPTION: writes all of buf into the pipe, blocking while it is full.
+ *                Page aligned, page sized pieces are handed over by sharing
+ *                the frame copy-on-write instead of copying.
+ *   INPUT: fd - write end
+ *          buf - user buffer
+ *          nbytes - number of bytes to write
+ *   OUTPUT: number of bytes written, -1 if there are no read ends left
+ */
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes){
+	pipe_t* p = fd_pipe(fd);
+	const uint8_t* src = (const uint8_t*)buf;
+	uint32_t done = 0;
+	uint32_t len, tail, frame;
+	uint32_t flags;
+
+	if(buf == NULL || nbytes < 0) return -1;
+
+	cli_and_save(flags);
+	while(done < (uint32_t)nbytes){
+		if(p->readers == 0) break;
+
+		if(p->count == 0 && can_flip((uint32_t)(src + done), nbytes - done)){
+			if(p->page_count == PIPE_PAGE_SLOTS){
+				sleep_on(p);
+				continue;
+			}
+			frame = share_user_page((uint32_t)(src + done));
+			if(frame != 0){
+				p->pages[(p->page_head + p->page_count) % PIPE_PAGE_SLOTS] = frame;
+				p->page_count++;
+				done += FRAME_SIZE;
+				wake_up(p);
+				continue;
+			}
+		}
+
+		/* bytes wait until queued pages are read */
+		if(p->page_count > 0 || p->count == PIPE_BUF_SIZE){
+			sleep_on(p);
+			continue;
+		}
+
+		tail = (p->head + p->count) % PIPE_BUF_SIZE;
+		len = PIPE_BUF_SIZE - p->count;
+		if(len > PIPE_BUF_SIZE - tail) len = PIPE_BUF_SIZE - tail;
+		if(len > nbytes - done) len = nbytes - done;
+		if(copy_from_user(p->buf + tail, src + done, len) != 0) break;
+		p->count += len;
+		done += len;
+		wake_up(p); // data for readers
+	}
+	restore_flags(flags);
+
+	if(done == 0 && nbytes > 0) return -1; // nobody will ever read it
+	return done;
+}
+
+/* pipe_close
+ *   DESCRIPTION: closes one end; the pipe is freed with its last end, and
+ *                blocked processes on the other side are woken up
+ *   INPUT: fd - pipe end
+ *   OUTPUT: 0
+ */
+int32_t pipe_close(int32_t fd){
+	pcb_t* current_pcb = get_curr_proc();
+	pipe_t* p = fd_pipe(fd);
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if(current_pcb->fd_array[fd].fxn_tbl_ptr == &pipe_read_ftable) p->readers--;
+	else p->writers--;
+
+	if(p->readers == 0 && p->writers == 0){
+		while(p->page_count > 0){
+			put_user_frame(p->pages[p->page_head]);
+			p->page_head = (p->page_head + 1) % PIPE_PAGE_SLOTS;
+			p->page_count--;
+		}
+		kfree(p);
+	}
+	else{
+		wake_up(p);
+	}
+	restore_flags(flags);
+	return 0;
+}
+
+/* pipe_poll
+ *   DESCRIPTION: readiness of a pipe end; the pipe itself is the channel
+ *                pipe_read and pipe_write wake up
+ *   INPUT: fd - pipe end
+ *          table - table of the poll call in progress
+ *   OUTPUT: POLLIN / POLLHUP for the read end, POLLOUT / POLLERR for the
+ *           write end
+ */
+uint32_t pipe_poll(int32_t fd, poll_table_t* table){
+	pcb_t* current_pcb = get_curr_proc();
+	pipe_t* p = fd_pipe(fd);
+	uint32_t mask = 0;
+
+	poll_wait(table, p);
+	if(current_pcb->fd_array[fd].fxn_tbl_ptr == &pipe_read_ftable){
+		if(p->count > 0 || p->page_count > 0) mask |= POLLIN;
+		if(p->writers == 0) mask |= POLLIN | POLLHUP; // read returns 0
+	}
+	else{
+		// bytes fit once queued pages are read, pages once bytes are
+		if((p->page_count == 0 && p->count < PIPE_BUF_SIZE) ||
+		   (p->count == 0 && p->page_count < PIPE_PAGE_SLOTS)) mask |= POLLOUT;
+		if(p->readers == 0) mask |= POLLERR;
+	}
+	return mask;
+}
+
+/* pipe_bad_write
+ *   DESCRIPTION: the read end can't be written
+ *   OUTPUT: -1
+ */
+int32_t pipe_bad_write(int32_t fd, const void* buf, int32_t nbytes){
+	return -1;
+}
+
+/* pipe_bad_read
+ *   DESCRIPTION: the write end can't be read
+ *   OUTPUT: -1
+ */
+int32_t pipe_bad_read(int32_t fd, void* buf, int32_t nbytes){
+	return -1;
+}
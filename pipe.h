@@ -0,0 +1,47 @@
+/* pipe.h - kernel pipes between processes
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "types.h"
+#include "syscalls.h"
+
+#define PIPE_PAGE_SLOTS		16 // flipped pages a pipe can hold
+#define PIPE_HEADER_SIZE	128 // room kept for the fields before buf
+#define PIPE_BUF_SIZE		(FRAME_SIZE - PIPE_HEADER_SIZE)
+
+/* one pipe, fills exactly one frame (kmalloc gives it a frame of its own).
+ * It holds either bytes in the ring buffer or whole pages handed over by page
+ * flipping, never both, so data comes out in the order it went in. */
+typedef struct pipe_t{
+	uint32_t readers;		// open read ends
+	uint32_t writers;		// open write ends
+	uint32_t head;			// ring buffer: first unread byte
+	uint32_t count;			// ring buffer: unread bytes
+	uint32_t page_head;		// page queue: first unread page
+	uint32_t page_count;	// page queue: unread pages
+	uint32_t page_off;		// bytes already read from the first page
+	uint32_t pages[PIPE_PAGE_SLOTS];	// physical frames, one reference each
+	uint8_t pad[PIPE_HEADER_SIZE - (7 + PIPE_PAGE_SLOTS) * sizeof(uint32_t)];
+	uint8_t buf[PIPE_BUF_SIZE];
+}pipe_t;
+
+extern fops_table pipe_read_ftable;
+extern fops_table pipe_write_ftable;
+
+/* creates a pipe; fills in the read and write ends */
+int32_t pipe_create(fd_t* read_end, fd_t* write_end);
+/* takes another reference on every pipe end of a copied fd table (fork) */
+void pipe_dup_fds(pcb_t* pcb);
+
+/* pipe end file operations */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t pipe_close(int32_t fd);
+uint32_t pipe_poll(int32_t fd, poll_table_t* table);
+int32_t pipe_bad_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t pipe_bad_read(int32_t fd, void* buf, int32_t nbytes);
+
+#endif /* PIPE_H */
@@ -3,8 +3,11 @@
 #include "paging.h"
 #include "keyboard.h"
 #include "i8259.h"
+#include "sched.h"
+#include "signal.h"
 /* num of current terminal(0,1,2) */
 uint8_t terminal_num = 0;
+uint32_t pit_ticks = 0;
 terminal_t terminal_arr[NUM_TERMINALS];
 
 /* pit_init
@@ -27,46 +30,40 @@ void pit_init(void){
 
 
 /* pit_handler
- *   DESCRIPTION: handler for when interrupt comes in; switch the process to that of 
- *                next terminal; in a roundrobin manner
+ *   DESCRIPTION: handler for when interrupt comes in; starts the shell of any
+ *                terminal that isn't running yet, otherwise preempts the
+ *                current process in favor of the next runnable one
  *   INPUT: none
  *   OUTPUT: none
  */
 void pit_handler(void){
+	int i;
 	send_eoi(PIT_IRQ);
-	/* set ptr to curr and next terminals */
-  terminal_t * curr_terminal = &(terminal_arr[terminal_num]);
-	terminal_num = (terminal_num + 1) % NUM_TERMINALS;
-  terminal_t * next_terminal = &(terminal_arr[terminal_num]);
-
-	/* save current ebp and esp0 */
-  asm volatile(
-    "movl %%ebp, %0"
-    :"=r"(curr_terminal->ebp)
-      );
-	curr_terminal->esp0 = tss.esp0;
-
-	/* next terminal should always be on; if not, turn it on */
-  if(next_terminal->active == OFF){
-		execute((const uint8_t*)"shell\n");  // execute next terminal
-  }
+	pit_ticks++;
+	wake_up(&pit_ticks); // poll timeouts
+	signal_tick();
 
-	/* set paging for upcoming process(move onto processes in next terminal) */
-	set_process_memory(next_terminal->most_recent_pcb->pid);
+	// interrupted the idle loop; it picks the next process itself
+	if(sched_idle) return;
 
-	/* store current terminal's esp0 into tss */
-  tss.esp0 = next_terminal->esp0;
-
-	/* set actual ebp to next terminal's ebp, to move to next terminal*/
-  asm volatile(
-			"movl %0, %%ebp;"
-			"leave;"
-			"ret;"
-			:
-			:
-			"r"(next_terminal->ebp)
-			);
+	/* every terminal should always be on; if not, turn it on */
+	for(i = 0; i < NUM_TERMINALS; i++){
+		if(terminal_arr[i].active == OFF){
+			/* current process resumes by returning from this handler */
+			pcb_t * curr = get_running_pcb();
+			if(curr != NULL){
+				asm volatile(
+					"movl %%ebp, %0"
+					:"=r"(curr->sched_ebp)
+				);
+			}
+			terminal_num = i;
+			execute((const uint8_t*)"shell\n");  // execute next terminal
+			if(curr != NULL) terminal_num = curr->tid; // only returns on failure
+		}
+	}
 
+	schedule();
 }
 
 /* terminal_init
@@ -22,14 +22,14 @@
 #define ON											 1
 
 extern uint8_t terminal_num;
+/* ticks since boot, every FREQ ms; wake_up(&pit_ticks) runs on each */
+extern uint32_t pit_ticks;
 
 /* struct to hold necessary info for each terminal */
 typedef struct {
 
- 	/* bookkeeping info for jumping between terminals */
+ 	/* foreground process of the terminal */
 	pcb_t * most_recent_pcb;
-	uint32_t ebp;
-	uint32_t esp0;
 
 	/* saving keyboard cursor pos and buffer */
 	uint8_t cursor_x;
@@ -0,0 +1,109 @@
+/* poll.c - waiting on several file descriptors at once
+ * vim:ts=4 noexpandtab
+ */
+
+#include "poll.h"
+#include "lib.h"
+#include "sched.h"
+#include "pit.h"
+
+/* poll_wait
+ *   DESCRIPTION: called by a fops poll callback with the channel its file
+ *                wakes up when it becomes ready. NULL table: nobody sleeps.
+ *   INPUT: table - table of the poll call in progress, may be NULL
+ *          chan - wait channel (see sleep_on)
+ *   OUTPUT: none
+ */
+void poll_wait(poll_table_t* table, void* chan){
+	if(table == NULL || poll_table_has(table, chan)) return;
+	// the last slot is kept for the tick channel
+	if(table->count == POLL_MAX_CHANS - 1){
+		table->overflow = 1;
+		return;
+	}
+	table->chans[table->count++] = chan;
+}
+
+/* poll_table_has
+ *   DESCRIPTION: checks if a table holds a channel
+ *   INPUT: table - poll table
+ *          chan - wait channel
+ *   OUTPUT: 1 if so, 0 if not
+ */
+int poll_table_has(poll_table_t* table, void* chan){
+	uint32_t i;
+	for(i = 0; i < table->count; i++){
+		if(table->chans[i] == chan) return 1;
+	}
+	return 0;
+}
+
+/* poll_scan
+ *   DESCRIPTION: asks every file for its readiness
+ *   INPUT: fds, nfds - entries to check
+ *          table - collects the wait channels, NULL to not collect them
+ *   OUTPUT: number of entries with something in revents, -1 if fds
+ *           isn't mapped
+ */
+static int32_t poll_scan(pollfd_t* fds, uint32_t nfds, poll_table_t* table){
+	pcb_t* current_pcb = get_curr_proc();
+	pollfd_t entry;
+	fd_t* file;
+	uint32_t i, mask;
+	int32_t ready = 0;
+
+	for(i = 0; i < nfds; i++){
+		if(copy_from_user(&entry, &fds[i], sizeof(pollfd_t)) != 0) return -1;
+		if(entry.fd < 0){ // ignored, as in posix
+			mask = 0;
+		}
+		else if(!fd_is_open(current_pcb, entry.fd)){
+			mask = POLLNVAL;
+		}
+		else{
+			file = &current_pcb->fd_array[entry.fd];
+			if(file->fxn_tbl_ptr->poll == NULL) mask = POLL_DEFAULT_MASK;
+			else mask = file->fxn_tbl_ptr->poll(entry.fd, table);
+			mask &= (entry.events | POLLERR | POLLHUP | POLLNVAL);
+		}
+		entry.revents = mask;
+		if(copy_to_user(&fds[i].revents, &entry.revents, sizeof(int16_t)) != 0) return -1;
+		if(mask) ready++;
+	}
+	return ready;
+}
+
+/* poll_fds
+ *   DESCRIPTION: waits until one of the files is ready. The process sleeps
+ *                on the wait channels of all the files at once and rescans
+ *                when any of them is woken up.
+ *   INPUT: fds - user array of entries
+ *          nfds - its length
+ *          timeout - ms to wait at most; 0 returns at once, -1 never times out
+ *   OUTPUT: number of ready entries, 0 on timeout or a pending signal,
+ *           -1 if fds isn't mapped
+ *   SIDE EFFECTS: fills in revents
+ */
+int32_t poll_fds(pollfd_t* fds, uint32_t nfds, int32_t timeout){
+	pcb_t* current_pcb = get_curr_pcb();
+	poll_table_t table;
+	uint32_t deadline = pit_ticks + (timeout + FREQ - 1) / FREQ;
+	uint32_t flags;
+	int32_t ready;
+
+	// interrupts stay off from a scan to its sleep, so no wake up is lost
+	cli_and_save(flags);
+	for(;;){
+		table.count = 0;
+		table.overflow = 0;
+		ready = poll_scan(fds, nfds, timeout == 0 ? NULL : &table);
+		if(ready != 0 || timeout == 0) break;
+		if(timeout > 0 && (int32_t)(pit_ticks - deadline) >= 0) break;
+		if(current_pcb->sig_pending != 0 && !current_pcb->sig_masked) break;
+
+		if(timeout > 0 || table.overflow) table.chans[table.count++] = &pit_ticks;
+		sleep_on_poll(&table);
+	}
+	restore_flags(flags);
+	return ready;
+}
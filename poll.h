@@ -0,0 +1,43 @@
+/* poll.h - waiting on several file descriptors at once
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef POLL_H
+#define POLL_H
+
+#include "types.h"
+#include "syscalls.h"
+
+/* pollfd_t.events / revents bits */
+#define POLLIN				0x01 // read won't block
+#define POLLOUT				0x04 // write won't block
+#define POLLERR				0x08 // write end with no reader left
+#define POLLHUP				0x10 // read end with no writer left
+#define POLLNVAL			0x20 // fd is not open
+#define POLL_DEFAULT_MASK	(POLLIN | POLLOUT) // files without a poll op
+
+#define POLL_MAX_CHANS		16 // wait channels one poll call sleeps on
+
+/* one entry of the array passed to poll */
+typedef struct pollfd_t{
+	int32_t fd;
+	int16_t events;		// what to wait for
+	int16_t revents;	// what is ready, filled in by poll
+}pollfd_t;
+
+/* channels a polling process sleeps on, filled by the fops poll callbacks
+ * through poll_wait; wake_up on any of them wakes the process */
+struct poll_table_t{
+	uint32_t count;
+	uint8_t overflow;	// more channels than fit; poll also wakes every tick
+	void* chans[POLL_MAX_CHANS];
+};
+
+/* registers chan with the table of the poll call in progress */
+void poll_wait(poll_table_t* table, void* chan);
+/* checks if chan is in the table */
+int poll_table_has(poll_table_t* table, void* chan);
+/* the body of the poll system call */
+int32_t poll_fds(pollfd_t* fds, uint32_t nfds, int32_t timeout);
+
+#endif /* POLL_H */
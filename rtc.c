@@ -3,6 +3,8 @@
 #include "lib.h"
 #include "i8259.h"
 #include "types.h"
+#include "sched.h"
+#include "poll.h"
 
 /* Static variable int rtc_signal becomes 1 when interrupt has occured*/
 static int rtc_signal;
@@ -48,6 +50,7 @@ void rtc_handler(){
   send_eoi(IRQ8); //rtc irq
   cli();
   rtc_signal = 1; //interrupt has occured
+  wake_up(&rtc_signal); // readers and pollers sleep on the flag
   /* enable interrupt again by reading register C */
   outb(R_C, RTC_PORT); //x0c, rtc port
   inb(RTC_DATA_PORT);  // just throw away contents
@@ -101,11 +104,26 @@ int32_t rtc_close(int32_t fd){
  *   SIDE EFFECTS: none
  */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes){
-  while(!rtc_signal); // stuck when interrupt has not occured yet
+  uint32_t flags;
+  cli_and_save(flags);
+  while(!rtc_signal) sleep_on(&rtc_signal); // sleep until the interrupt occurs
   rtc_signal = 0; // clears flag immediately after the interrupt happened
+  restore_flags(flags);
   return 0; // tells the interrupt has happened
 }
 
+/* rtc_poll
+ *   DESCRIPTION: readiness of the rtc for poll
+ *   INPUT: fd - file number
+ *          table - table of the poll call in progress
+ *   OUTPUT: POLLIN if an interrupt has occured since the last read
+ *   SIDE EFFECTS: none
+ */
+uint32_t rtc_poll(int32_t fd, poll_table_t* table){
+  poll_wait(table, &rtc_signal);
+  return rtc_signal ? POLLIN : 0;
+}
+
 /* rtc_write
  *   DESCRIPTION: updates the frequency of the rtc,
  *   INPUT: fd - file number
@@ -116,10 +134,10 @@ int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes){
  *   SIDE EFFECTS: change the freqency of rtc
  */
 int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes){
-  int freq = *(uint32_t *)buf;
+  int freq;
   int rate = 0;   //if 2hz is buf then 2 can be divided into two while we want value 1
   int rest = 0;
-  if ((nbytes != sizeof(uint32_t)) | (freq <= 1)){ // if nbytes and freq is not proper, return -1
+  if ((nbytes != sizeof(uint32_t)) || copy_from_user(&freq, buf, sizeof(uint32_t)) != 0 || (freq <= 1)){ // if nbytes and freq is not proper, return -1
     return -1;
   }
   while(freq > 1){ // calculate the log base 2 of frequency
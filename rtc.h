@@ -34,5 +34,8 @@ int32_t rtc_close(int32_t fd);
 int32_t rtc_read(int32_t fd, void * buf, int32_t nbytes);
 /* sets new frequency for the rtc */
 int32_t rtc_write(int32_t fd, const void * buf, int32_t nbytes);
+struct poll_table_t; // see poll.h
+/* readable once an interrupt has occured, for poll */
+uint32_t rtc_poll(int32_t fd, struct poll_table_t * table);
 
 #endif
@@ -0,0 +1,260 @@
+/* sched.c - process table and round-robin scheduler
+ * vim:ts=4 noexpandtab
+ */
+
+#include "sched.h"
+#include "lib.h"
+#include "paging.h"
+#include "pit.h"
+#include "isr_wrapper.h"
+#include "x86_desc.h"
+#include "poll.h"
+
+/* every process, newest first; linked through the pcbs */
+pcb_t* process_list = NULL;
+
+/* set while schedule waits for something to become runnable */
+uint8_t sched_idle = 0;
+
+/* sched_add
+ *   DESCRIPTION: registers a new process with the scheduler
+ *   INPUT: pcb - the new process
+ *   OUTPUT: none
+ */
+void sched_add(pcb_t* pcb){
+	pcb->state = PROC_RUNNABLE;
+	pcb->wait_chan = NULL;
+	pcb->prev_proc = NULL;
+	pcb->next_proc = process_list;
+	if(process_list != NULL) process_list->prev_proc = pcb;
+	process_list = pcb;
+}
+
+/* sched_remove
+ *   DESCRIPTION: forgets a process; its pid may be reused afterwards
+ *   INPUT: pcb - the process
+ *   OUTPUT: none
+ */
+void sched_remove(pcb_t* pcb){
+	if(pcb->prev_proc != NULL) pcb->prev_proc->next_proc = pcb->next_proc;
+	else process_list = pcb->next_proc;
+	if(pcb->next_proc != NULL) pcb->next_proc->prev_proc = pcb->prev_proc;
+	pcb->next_proc = NULL;
+	pcb->prev_proc = NULL;
+}
+
+/* get_running_pcb
+ *   DESCRIPTION: like get_curr_pcb, but checks that the kernel stack really
+ *                belongs to a process (at boot we run on the boot stack
+ *                below KERNEL_STACK_START; process stacks come from the pool)
+ *   INPUT: none
+ *   OUTPUT: current pcb, NULL if no process is running yet
+ */
+pcb_t* get_running_pcb(void){
+	pcb_t* pcb = get_curr_pcb();
+	if((uint32_t)pcb >= USER_FRAME_POOL_START && (uint32_t)pcb < USER_FRAME_POOL_END)
+		return pcb;
+	return NULL;
+}
+
+/* init_child_context
+ *   DESCRIPTION: builds the first context of a process that does not start
+ *                through execute's iret (spawn, fork). frame is a syscall
+ *                frame at the top of the process's kernel stack; right below
+ *                it sits a fake "leave; ret" frame returning to CHILD_RETURN,
+ *                which unwinds frame into user space.
+ *   INPUT: pcb - the new process
+ *          frame - syscall frame on its kernel stack
+ *   OUTPUT: none
+ */
+void init_child_context(pcb_t* pcb, uint32_t* frame){
+	frame[-1] = (uint32_t)CHILD_RETURN; // ret address
+	frame[-2] = 0;                      // ebp popped by leave
+	pcb->sched_ebp = (uint32_t)&frame[-2];
+}
+
+/* pick_next
+ *   DESCRIPTION: round robin; first runnable process after curr in the
+ *                process list, wrapping around to curr itself
+ *   INPUT: curr - current process, may be NULL or already unlinked
+ *   OUTPUT: next process to run, NULL if nothing is runnable
+ */
+static pcb_t* pick_next(pcb_t* curr){
+	pcb_t* pcb;
+	pcb_t* start = (curr == NULL) ? NULL : curr->next_proc;
+
+	for(pcb = start; pcb != NULL; pcb = pcb->next_proc){
+		if(pcb->state == PROC_RUNNABLE) return pcb;
+	}
+	for(pcb = process_list; pcb != start; pcb = pcb->next_proc){
+		if(pcb->state == PROC_RUNNABLE) return pcb;
+	}
+	return NULL;
+}
+
+/* context_switch
+ *   DESCRIPTION: saves this frame's ebp in curr, then loads next's paging,
+ *                kernel stack and terminal and returns on next's saved ebp.
+ *                curr resumes by returning from this function.
+ *   INPUT: curr - process switched out (NULL if it never resumes)
+ *          next - process switched in
+ *   OUTPUT: none
+ */
+static void context_switch(pcb_t* curr, pcb_t* next){
+	if(curr != NULL){
+		asm volatile(
+			"movl %%ebp, %0"
+			:"=r"(curr->sched_ebp)
+		);
+	}
+
+	// threads of one process share the loaded page tables
+	if(curr == NULL || curr->leader != next->leader) set_process_memory(&next->leader->mem);
+	tss.esp0 = KERNEL_STACK_TOP(next);
+	terminal_num = next->tid;
+
+	asm volatile(
+		"movl %0, %%ebp;"
+		"leave;"
+		"ret;"
+		:
+		:"r"(next->sched_ebp)
+	);
+}
+
+/* wait_for_runnable
+ *   DESCRIPTION: idles with interrupts on until some process is runnable,
+ *                zeroing frames for later page faults and merging identical
+ *                pages before halting.
+ *                Interrupts taken meanwhile stay on this stack; the pit
+ *                handler sees sched_idle and does not schedule.
+ *   INPUT: curr - current process
+ *   OUTPUT: the next process to run
+ */
+static pcb_t* wait_for_runnable(pcb_t* curr){
+	pcb_t* next;
+	sched_idle = 1;
+	while((next = pick_next(curr)) == NULL){
+		if(!zero_idle_frame() && !merge_idle_pages()) asm volatile("sti; hlt; cli;");
+	}
+	sched_idle = 0;
+	return next;
+}
+
+/* schedule
+ *   DESCRIPTION: gives the cpu to the next runnable process. Called from the
+ *                pit handler for preemption, and by sleep_on.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   SIDE EFFECTS: may switch processes; returns once this one runs again
+ */
+void schedule(void){
+	uint32_t flags;
+	cli_and_save(flags);
+
+	pcb_t* curr = get_running_pcb();
+	if(!sched_idle && curr != NULL){
+		pcb_t* next = wait_for_runnable(curr);
+		if(next != curr) context_switch(curr, next);
+	}
+
+	restore_flags(flags);
+}
+
+/* schedule_exit
+ *   DESCRIPTION: leaves a process that has halted for good. A process that
+ *                reaped itself still runs on its kernel stack; the stack is
+ *                freed only after idling, right before the switch, so nothing
+ *                (idle zeroing, interrupt handlers) can be handed its frames
+ *                while they are in use.
+ *   INPUT: reaped - the current process if it reaped itself, NULL if it is
+ *                   left as a zombie
+ *   OUTPUT: none, never returns
+ */
+void schedule_exit(pcb_t* reaped){
+	pcb_t* next;
+
+	cli();
+	next = wait_for_runnable(get_curr_pcb());
+	if(reaped != NULL) free_kernel_stack((uint32_t)reaped);
+	context_switch(NULL, next);
+}
+
+/* sleep_on
+ *   DESCRIPTION: blocks the current process until someone calls
+ *                wake_up(chan). Callers check their condition and sleep with
+ *                interrupts off, so a wake_up can't slip in between.
+ *   INPUT: chan - anything identifying what is waited for
+ *   OUTPUT: none
+ */
+void sleep_on(void* chan){
+	uint32_t flags;
+	pcb_t* curr = get_running_pcb();
+
+	cli_and_save(flags);
+	if(curr == NULL){
+		// no process yet (tests at boot): wait for any interrupt instead
+		asm volatile("sti; hlt; cli;");
+		restore_flags(flags);
+		return;
+	}
+	curr->wait_chan = chan;
+	curr->state = PROC_BLOCKED;
+	schedule();
+	restore_flags(flags);
+}
+
+/* sleep_on_poll
+ *   DESCRIPTION: like sleep_on, but wakes up on any channel of a poll table
+ *   INPUT: table - channels to wait for
+ *   OUTPUT: none
+ */
+void sleep_on_poll(poll_table_t* table){
+	uint32_t flags;
+	pcb_t* curr = get_curr_pcb();
+
+	cli_and_save(flags);
+	curr->poll_table = table;
+	curr->state = PROC_BLOCKED;
+	schedule();
+	curr->poll_table = NULL;
+	restore_flags(flags);
+}
+
+/* wake_up_nr
+ *   DESCRIPTION: makes at most nr processes sleeping on chan runnable
+ *   INPUT: chan - what was waited for
+ *          nr - how many to wake
+ *   OUTPUT: number of processes woken
+ */
+uint32_t wake_up_nr(void* chan, uint32_t nr){
+	pcb_t* pcb;
+	uint32_t woken = 0;
+
+	for(pcb = process_list; pcb != NULL && woken < nr; pcb = pcb->next_proc){
+		if(pcb->state == PROC_BLOCKED && pcb->wait_chan == chan){
+			pcb->state = PROC_RUNNABLE;
+			pcb->wait_chan = NULL;
+			woken++;
+		}
+	}
+	return woken;
+}
+
+/* wake_up
+ *   DESCRIPTION: makes every process sleeping on chan runnable again
+ *   INPUT: chan - what was waited for
+ *   OUTPUT: none
+ */
+void wake_up(void* chan){
+	pcb_t* pcb;
+
+	for(pcb = process_list; pcb != NULL; pcb = pcb->next_proc){
+		if(pcb->state != PROC_BLOCKED) continue;
+		if(pcb->wait_chan == chan ||
+		   (pcb->poll_table != NULL && poll_table_has(pcb->poll_table, chan))){
+			pcb->state = PROC_RUNNABLE;
+			pcb->wait_chan = NULL;
+		}
+	}
+}
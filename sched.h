@@ -0,0 +1,44 @@
+/* sched.h - process table and round-robin scheduler
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "types.h"
+#include "syscalls.h"
+
+/* pcb_t.state values */
+#define PROC_RUNNABLE			0 // may be picked by schedule
+#define PROC_BLOCKED			1 // sleeping on pcb_t.wait_chan or poll_table
+#define PROC_EXECUTING		2 // held in execute until its child halts
+#define PROC_ZOMBIE				3 // halted, exit status not collected yet
+
+/* every process, linked through pcb_t.next_proc */
+extern pcb_t* process_list;
+/* set while the scheduler idles waiting for a runnable process */
+extern uint8_t sched_idle;
+
+/* puts a new process in the table, runnable */
+void sched_add(pcb_t* pcb);
+/* takes a process out of the table */
+void sched_remove(pcb_t* pcb);
+/* gets the process running on this kernel stack, NULL before the first one */
+pcb_t* get_running_pcb(void);
+/* lays out a first context that leaves through CHILD_RETURN with frame */
+void init_child_context(pcb_t* pcb, uint32_t* frame);
+
+/* gives the cpu to the next runnable process, round robin */
+void schedule(void);
+/* blocks the current process until wake_up(chan) */
+void sleep_on(void* chan);
+/* blocks the current process until wake_up on any channel of table */
+void sleep_on_poll(poll_table_t* table);
+/* makes every process sleeping on chan runnable */
+void wake_up(void* chan);
+/* makes at most nr processes sleeping on chan runnable, returns how many */
+uint32_t wake_up_nr(void* chan, uint32_t nr);
+/* switches away from a process that halted, never returns */
+void schedule_exit(pcb_t* reaped);
+
+#endif /* SCHED_H */
@@ -0,0 +1,147 @@
+/* shm.c - named shared memory segments
+ * vim:ts=4 noexpandtab
+ */
+
+#include "shm.h"
+#include "lib.h"
+#include "paging.h"
+
+static shm_segment_t shm_segments[SHM_MAX_SEGMENTS];
+
+/* shm_find
+ *   DESCRIPTION: looks a segment up by name
+ *   INPUT: name - segment name
+ *   OUTPUT: index of the segment, -1 if there is none by that name
+ */
+static int32_t shm_find(const uint8_t* name){
+	int32_t i;
+	for(i = 0; i < SHM_MAX_SEGMENTS; i++){
+		if(shm_segments[i].num_pages != 0 &&
+		   strncmp((const int8_t*)shm_segments[i].name, (const int8_t*)name, SHM_NAME_SIZE) == 0)
+			return i;
+	}
+	return -1;
+}
+
+/* shm_create
+ *   DESCRIPTION: makes a new, zeroed segment
+ *   INPUT: name - segment name
+ *          num_pages - size in pages
+ *   OUTPUT: index of the segment, -1 if no slot or frames are left
+ */
+static int32_t shm_create(const uint8_t* name, uint32_t num_pages){
+	int32_t i;
+	uint32_t j;
+	shm_segment_t* seg;
+
+	for(i = 0; i < SHM_MAX_SEGMENTS; i++){
+		if(shm_segments[i].num_pages == 0) break;
+	}
+	if(i == SHM_MAX_SEGMENTS) return -1;
+
+	seg = &shm_segments[i];
+	for(j = 0; j < num_pages; j++){
+		seg->frames[j] = alloc_zeroed_frame();
+		if(seg->frames[j] == 0){
+			while(j > 0) put_user_frame(seg->frames[--j]);
+			return -1;
+		}
+	}
+	strncpy((int8_t*)seg->name, (const int8_t*)name, SHM_NAME_SIZE - 1);
+	seg->name[SHM_NAME_SIZE - 1] = '\0';
+	seg->num_pages = num_pages;
+	seg->attached = 0;
+	return i;
+}
+
+/* shm_put
+ *   DESCRIPTION: drops one attachment; the last one frees the segment. The
+ *                frames themselves stay alive while still mapped somewhere.
+ *   INPUT: idx - segment index
+ *   OUTPUT: none
+ */
+static void shm_put(int32_t idx){
+	uint32_t j;
+	shm_segment_t* seg = &shm_segments[idx];
+
+	if(--seg->attached > 0) return;
+	for(j = 0; j < seg->num_pages; j++){
+		put_user_frame(seg->frames[j]);
+	}
+	seg->num_pages = 0;
+}
+
+/* shm_attach
+ *   DESCRIPTION: maps the segment called name at addr in the current
+ *                process, creating it (size bytes, zeroed) if it doesn't
+ *                exist yet. An existing segment is mapped up to size bytes.
+ *   INPUT: name - segment name, a user string (cut to SHM_NAME_SIZE - 1)
+ *          addr - page aligned address in the user page
+ *          size - bytes to map
+ *   OUTPUT: index of the segment, -1 if the arguments are bad (name can't
+ *           be read, a page can't be mapped there) or memory ran out
+ *   SIDE EFFECTS: replaces the pages at addr
+ */
+int32_t shm_attach(const uint8_t* name, uint32_t addr, uint32_t size){
+	pcb_t* current_pcb = get_curr_proc();
+	uint32_t num_pages = (size + FRAME_SIZE - 1) >> ALIGN;
+	uint8_t kname[SHM_NAME_SIZE];
+	uint32_t j;
+	int32_t idx;
+
+	// work on a kernel copy of the name
+	if(name == NULL || bad_userspace_addr(name, 1) ||
+	   safe_strncpy((int8_t*)kname, (const int8_t*)name, SHM_NAME_SIZE - 1) == -1)
+		return -1;
+	kname[SHM_NAME_SIZE - 1] = '\0';
+	name = kname;
+
+	if(name[0] == '\0' || num_pages == 0 || num_pages > SHM_MAX_PAGES ||
+	   (addr & ~FRAME_MASK) != 0 || addr < VIRTUAL_ADDR_START ||
+	   addr + (num_pages << ALIGN) > VIRTUAL_ADDR_START + USER_SPACE_SIZE)
+		return -1;
+
+	idx = shm_find(name);
+	if(idx == -1) idx = shm_create(name, num_pages);
+	if(idx == -1) return -1;
+	if(num_pages > shm_segments[idx].num_pages) num_pages = shm_segments[idx].num_pages;
+
+	for(j = 0; j < num_pages; j++){
+		if(map_shared_page(addr + (j << ALIGN), shm_segments[idx].frames[j]) == -1) break;
+	}
+
+	// pages mapped before a failure (e.g. at the stack guard) stay attached
+	if(!(current_pcb->shm_mask & (1 << idx))){
+		current_pcb->shm_mask |= (1 << idx);
+		shm_segments[idx].attached++;
+	}
+	return (j == num_pages) ? idx : -1;
+}
+
+/* shm_dup
+ *   DESCRIPTION: a process was copied (fork) along with its mappings; the
+ *                copy holds the same segments
+ *   INPUT: shm_mask - segments the copy has attached
+ *   OUTPUT: none
+ */
+void shm_dup(uint32_t shm_mask){
+	int32_t i;
+	for(i = 0; i < SHM_MAX_SEGMENTS; i++){
+		if(shm_mask & (1 << i)) shm_segments[i].attached++;
+	}
+}
+
+/* shm_detach_all
+ *   DESCRIPTION: drops every segment a halting process (or a root shell
+ *                that restarts) has attached; its mappings go away with its
+ *                page table, or are replaced when the pages are mapped again
+ *   INPUT: pcb - the halting process
+ *   OUTPUT: none
+ */
+void shm_detach_all(pcb_t* pcb){
+	int32_t i;
+	for(i = 0; i < SHM_MAX_SEGMENTS; i++){
+		if(pcb->shm_mask & (1 << i)) shm_put(i);
+	}
+	pcb->shm_mask = 0;
+}
@@ -0,0 +1,29 @@
+/* shm.h - named shared memory segments
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef SHM_H
+#define SHM_H
+
+#include "types.h"
+#include "syscalls.h"
+
+#define SHM_NAME_SIZE		32 // same as a file name
+#define SHM_MAX_PAGES		64 // 256KB per segment
+
+/* a named run of frames any process can map */
+typedef struct shm_segment_t{
+	uint8_t name[SHM_NAME_SIZE];
+	uint32_t num_pages;				// 0 if the slot is free
+	uint32_t attached;				// processes that have it mapped
+	uint32_t frames[SHM_MAX_PAGES];	// physical frames, one reference each
+}shm_segment_t;
+
+/* maps a segment into the current process, creating it if needed */
+int32_t shm_attach(const uint8_t* name, uint32_t addr, uint32_t size);
+/* a copy of a process was made (fork); counts its attachments */
+void shm_dup(uint32_t shm_mask);
+/* drops every segment a halting process has attached */
+void shm_detach_all(pcb_t* pcb);
+
+#endif /* SHM_H */
@@ -0,0 +1,217 @@
+/* signal.c - signals delivered to user programs
+ * vim:ts=4 noexpandtab
+ */
+
+#include "signal.h"
+#include "lib.h"
+#include "x86_desc.h"
+#include "paging.h"
+#include "pit.h"
+#include "terminal.h"
+#include "sched.h"
+
+/* movl $10, %eax; int $0x80 - calls sigreturn when a handler returns */
+static const uint8_t sig_trampoline[] = {0xB8, 0x0A, 0x00, 0x00, 0x00, 0xCD, 0x80};
+#define SIG_TRAMPOLINE_SIZE	8 // sig_trampoline padded to keep the stack aligned
+
+static uint32_t alarm_ticks;
+
+/* send_signal
+ *   DESCRIPTION: marks a signal pending; it is delivered the next time the
+ *                process returns to user mode
+ *   INPUT: pcb - receiving process
+ *          signum - signal number
+ *   OUTPUT: none
+ */
+void send_signal(pcb_t* pcb, uint32_t signum){
+	if(pcb == NULL || signum >= NUM_SIGNALS) return;
+	pcb->sig_pending |= (1 << signum);
+	// poll gives up on a signal; other sleeps wait for their event
+	if(pcb->state == PROC_BLOCKED && pcb->poll_table != NULL) pcb->state = PROC_RUNNABLE;
+}
+
+/* kill_process
+ *   DESCRIPTION: default action of a fatal signal: the whole process ends.
+ *                The first thread halts it with its other threads. Another
+ *                thread ends itself and marks the process; the first thread
+ *                halts it on its next return to user mode, like a signal
+ *                sent to it.
+ *   INPUT: none
+ *   OUTPUT: none, never returns
+ */
+static void kill_process(void){
+	pcb_t* current_pcb = get_curr_pcb();
+	pcb_t* leader = current_pcb->leader;
+
+	if(leader != current_pcb){
+		leader->group_exit = 1;
+		// poll gives up on a signal; other sleeps wait for their event
+		if(leader->state == PROC_BLOCKED && leader->poll_table != NULL) leader->state = PROC_RUNNABLE;
+	}
+	halt(SIG_KILL_STATUS);
+}
+
+/* exception_signal
+ *   DESCRIPTION: an exception hit. A user program with a handler for signum
+ *                gets the signal; otherwise it is halted with the message,
+ *                as every exception used to be.
+ *   INPUT: frame - registers saved by the exception wrapper
+ *          signum - signal the exception maps to
+ *          message - printed when the process is halted
+ *   OUTPUT: none
+ *   SIDE EFFECTS: may halt the current process
+ */
+void exception_signal(int_frame_t* frame, uint32_t signum, const uint8_t* message){
+	pcb_t* current_pcb = get_curr_pcb();
+
+	cli();
+	if((frame->cs & 0xFFFF) != USER_CS || current_pcb->sig_masked ||
+	   current_pcb->leader->sig_handler[signum] == NULL){
+		terminal_write(0, (void*)message, strlen((const int8_t*)message));
+		kill_process();
+	}
+	send_signal(current_pcb, signum);
+}
+
+/* next_signal
+ *   DESCRIPTION: takes the lowest pending signal of the current process and
+ *                runs its default action if it has no handler
+ *   INPUT: none
+ *   OUTPUT: signal to run the handler of, -1 if there is none
+ *   SIDE EFFECTS: may halt the current process (all of it if a thread
+ *                 of it took a fatal signal)
+ */
+static int32_t next_signal(void){
+	pcb_t* current_pcb = get_curr_pcb();
+	uint32_t signum;
+
+	if(current_pcb->leader->group_exit) halt(SIG_KILL_STATUS);
+	while(!current_pcb->sig_masked && current_pcb->sig_pending != 0){
+		asm volatile("bsfl %1, %0" : "=r"(signum) : "r"(current_pcb->sig_pending));
+		current_pcb->sig_pending &= ~(1 << signum);
+
+		if(current_pcb->leader->sig_handler[signum] != NULL) return signum;
+		if(signum == SIG_DIV_ZERO || signum == SIG_SEGFAULT || signum == SIG_INTERRUPT)
+			kill_process();
+		// SIG_ALARM and SIG_USER1 are ignored by default
+	}
+	return -1;
+}
+
+/* setup_signal_frame
+ *   DESCRIPTION: builds the handler's frame on the user stack: the sigreturn
+ *                trampoline, the interrupted context, signum and a return
+ *                address pointing at the trampoline
+ *   INPUT: signum - signal to deliver
+ *          ctx - interrupted user context
+ *   OUTPUT: user esp to enter the handler with
+ *   SIDE EFFECTS: ends the process if its stack can't hold the frame
+ */
+static uint32_t setup_signal_frame(uint32_t signum, sig_context_t* ctx){
+	pcb_t* current_pcb = get_curr_pcb();
+	uint32_t tramp = ((ctx->esp - SIG_TRAMPOLINE_SIZE) & ~0x3);
+	uint32_t ctx_addr = tramp - sizeof(sig_context_t);
+	uint32_t esp = ctx_addr - 2 * sizeof(uint32_t);
+	uint32_t args[2];
+
+	// the stack may be a thread's in the heap; a full one hits the guard
+	// page (or unmapped heap) and the copies below fail
+	if(esp > ctx->esp || bad_userspace_addr((void*)esp, ctx->esp - esp))
+		kill_process();
+
+	args[0] = tramp; // return address
+	args[1] = signum;
+	if(copy_to_user((void*)tramp, sig_trampoline, sizeof(sig_trampoline)) != 0 ||
+	   copy_to_user((void*)ctx_addr, ctx, sizeof(sig_context_t)) != 0 ||
+	   copy_to_user((void*)esp, args, sizeof(args)) != 0)
+		kill_process();
+
+	current_pcb->sig_masked = 1;
+	return esp;
+}
+
+/* signal_return_syscall
+ *   DESCRIPTION: runs on the way out of every system call; if a signal is
+ *                to be handled, the iret is pointed at its handler
+ *   INPUT: frame - the system call frame (see SYSCALL_FRAME_SIZE)
+ *          ret - value the system call returns
+ *   OUTPUT: value to return in eax
+ */
+int32_t signal_return_syscall(uint32_t* frame, int32_t ret){
+	pcb_t* current_pcb = get_curr_pcb();
+	sig_context_t ctx;
+	int32_t signum;
+
+	if((frame[SYSCALL_FRAME_CS] & 0xFFFF) != USER_CS ||
+	   (current_pcb->sig_pending == 0 && !current_pcb->leader->group_exit))
+		return ret;
+
+	cli(); // the iret brings IF back
+	signum = next_signal();
+	if(signum == -1) return ret;
+
+	ctx.ebx = frame[SYSCALL_FRAME_EBX];
+	ctx.ecx = frame[SYSCALL_FRAME_ECX];
+	ctx.edx = frame[SYSCALL_FRAME_EDX];
+	ctx.esi = frame[SYSCALL_FRAME_ESI];
+	ctx.edi = frame[SYSCALL_FRAME_EDI];
+	ctx.ebp = frame[SYSCALL_FRAME_EBP];
+	ctx.eax = ret;
+	ctx.eip = frame[SYSCALL_FRAME_EIP];
+	ctx.eflags = frame[SYSCALL_FRAME_EFLAGS];
+	ctx.esp = frame[SYSCALL_FRAME_ESP];
+
+	frame[SYSCALL_FRAME_ESP] = setup_signal_frame(signum, &ctx);
+	frame[SYSCALL_FRAME_EIP] = (uint32_t)current_pcb->leader->sig_handler[signum];
+	return signum;
+}
+
+/* signal_return_interrupt
+ *   DESCRIPTION: runs on the way out of every exception and interrupt; if a
+ *                signal is to be handled, the iret is pointed at its handler
+ *   INPUT: frame - registers saved by the wrapper
+ *   OUTPUT: none
+ */
+void signal_return_interrupt(int_frame_t* frame){
+	pcb_t* current_pcb = get_curr_pcb();
+	sig_context_t ctx;
+	int32_t signum;
+
+	if((frame->cs & 0xFFFF) != USER_CS ||
+	   (current_pcb->sig_pending == 0 && !current_pcb->leader->group_exit))
+		return;
+
+	signum = next_signal();
+	if(signum == -1) return;
+
+	ctx.ebx = frame->ebx;
+	ctx.ecx = frame->ecx;
+	ctx.edx = frame->edx;
+	ctx.esi = frame->esi;
+	ctx.edi = frame->edi;
+	ctx.ebp = frame->ebp;
+	ctx.eax = frame->eax;
+	ctx.eip = frame->eip;
+	ctx.eflags = frame->eflags;
+	ctx.esp = frame->esp;
+
+	frame->esp = setup_signal_frame(signum, &ctx);
+	frame->eip = (uint32_t)current_pcb->leader->sig_handler[signum];
+	frame->eax = signum;
+}
+
+/* signal_tick
+ *   DESCRIPTION: counts pit ticks and sends SIG_ALARM to the foreground
+ *                program of every terminal each ALARM_SECONDS
+ *   INPUT: none
+ *   OUTPUT: none
+ */
+void signal_tick(void){
+	int i;
+
+	if(++alarm_ticks < ALARM_SECONDS * MILLI_INV / FREQ) return;
+	alarm_ticks = 0;
+	for(i = 0; i < NUM_TERMINALS; i++){
+		send_signal(terminal_arr[i].most_recent_pcb, SIG_ALARM);
+	}
+}
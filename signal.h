@@ -0,0 +1,45 @@
+/* signal.h - signals delivered to user programs
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef SIGNAL_H
+#define SIGNAL_H
+
+#include "types.h"
+#include "syscalls.h"
+#include "interrupt_handler.h"
+
+/* signal numbers */
+#define SIG_DIV_ZERO		0 // divide error; default: kill
+#define SIG_SEGFAULT		1 // any other exception; default: kill
+#define SIG_INTERRUPT		2 // ctrl+c in the program's terminal; default: kill
+#define SIG_ALARM			3 // every ALARM_SECONDS; default: ignore
+#define SIG_USER1			4 // default: ignore
+/* NUM_SIGNALS lives in syscalls.h, the pcb needs it */
+
+#define ALARM_SECONDS		10
+#define SIG_KILL_STATUS		255 // halt status of a process killed by a signal
+#define SIG_EFLAGS_MASK		0xDD5 // flags a handler may change: CF PF AF ZF SF TF DF OF
+
+/* what a handler's stack holds above the return address and signum;
+ * sigreturn puts it back */
+typedef struct sig_context_t{
+	uint32_t ebx, ecx, edx, esi, edi, ebp, eax;
+	uint32_t eip, eflags, esp;
+}sig_context_t;
+
+/* marks a signal pending for a process */
+void send_signal(pcb_t* pcb, uint32_t signum);
+/* an exception hit: signal the program, or kill it (as before) if it can't
+ * handle the signal or the fault is the kernel's */
+void exception_signal(int_frame_t* frame, uint32_t signum, const uint8_t* message);
+
+/* called on every way back to user mode; deliver pending signals by
+ * redirecting the return to the handler */
+int32_t signal_return_syscall(uint32_t* frame, int32_t ret);
+void signal_return_interrupt(int_frame_t* frame);
+
+/* sends SIG_ALARM every ALARM_SECONDS; called by the pit handler */
+void signal_tick(void);
+
+#endif /* SIGNAL_H */
@@ -0,0 +1,196 @@
+/* slab.c - allocator for kernel objects
+ * vim:ts=4 noexpandtab
+ *
+ * Objects of one size are carved out of 4KB frames from the frame pool.
+ * Allocating and freeing is a push or pop on the free list of a slab, so
+ * both are constant time and a slab never fragments. kmalloc picks a size
+ * class cache; anything bigger than the largest class gets a frame of its
+ * own, which kfree recognizes by its frame aligned address (slab objects
+ * never start a frame, the header does).
+ */
+
+#include "slab.h"
+#include "lib.h"
+#include "paging.h"
+
+#define SLAB_HEADER_SIZE	((sizeof(slab_t) + 0xF) & ~0xF)
+#define SLAB_MAX_OBJ		(FRAME_SIZE - SLAB_HEADER_SIZE)
+
+static kmem_cache_t caches[SLAB_MAX_CACHES];
+static uint32_t num_caches = 0;
+static kmem_cache_t* kmalloc_caches[KMALLOC_CLASSES];
+
+/* slab_init
+ *   DESCRIPTION: makes the kmalloc size class caches
+ *   INPUT: none
+ *   OUTPUT: none
+ */
+void slab_init(void){
+	static const int8_t* names[KMALLOC_CLASSES] = {
+		(int8_t*)"kmalloc-16", (int8_t*)"kmalloc-32", (int8_t*)"kmalloc-64", (int8_t*)"kmalloc-128",
+		(int8_t*)"kmalloc-256", (int8_t*)"kmalloc-512", (int8_t*)"kmalloc-1024", (int8_t*)"kmalloc-2048"
+	};
+	uint32_t i;
+
+	for(i = 0; i < KMALLOC_CLASSES; i++){
+		kmalloc_caches[i] = kmem_cache_create(names[i], KMALLOC_MIN_SIZE << i);
+	}
+}
+
+/* kmem_cache_create
+ *   DESCRIPTION: makes a cache for objects of one size
+ *   INPUT: name - for debugging
+ *          size - object size in bytes
+ *   OUTPUT: the cache, NULL if size doesn't fit a slab or no cache is left
+ */
+kmem_cache_t* kmem_cache_create(const int8_t* name, uint32_t size){
+	kmem_cache_t* cache;
+	uint32_t flags;
+
+	size = (size + 3) & ~3; // keep objects word aligned
+	if(size < sizeof(void*)) size = sizeof(void*);
+	if(size > SLAB_MAX_OBJ) return NULL;
+
+	cli_and_save(flags);
+	if(num_caches == SLAB_MAX_CACHES){
+		restore_flags(flags);
+		return NULL;
+	}
+	cache = &caches[num_caches++];
+	restore_flags(flags);
+
+	cache->name = name;
+	cache->obj_size = size;
+	cache->per_slab = SLAB_MAX_OBJ / size;
+	cache->partial = NULL;
+	cache->active = 0;
+	cache->slabs = 0;
+	return cache;
+}
+
+/* slab_grow
+ *   DESCRIPTION: gives a cache a new slab with all objects free
+ *   INPUT: cache - the cache
+ *   OUTPUT: the slab, put on the partial list; NULL if no frame is left
+ */
+static slab_t* slab_grow(kmem_cache_t* cache){
+	slab_t* slab = (slab_t*)alloc_user_frame();
+	uint8_t* obj;
+	uint32_t i;
+
+	if(slab == NULL) return NULL;
+
+	slab->cache = cache;
+	slab->in_use = 0;
+	slab->free_list = NULL;
+	obj = (uint8_t*)slab + SLAB_HEADER_SIZE + (cache->per_slab - 1) * cache->obj_size;
+	for(i = 0; i < cache->per_slab; i++, obj -= cache->obj_size){
+		*(void**)obj = slab->free_list;
+		slab->free_list = obj;
+	}
+
+	slab->prev = NULL;
+	slab->next = cache->partial;
+	if(cache->partial != NULL) cache->partial->prev = slab;
+	cache->partial = slab;
+	cache->slabs++;
+	return slab;
+}
+
+/* slab_unlink
+ *   DESCRIPTION: takes a slab off its cache's partial list
+ *   INPUT: slab - a slab on the list
+ *   OUTPUT: none
+ */
+static void slab_unlink(slab_t* slab){
+	if(slab->prev != NULL) slab->prev->next = slab->next;
+	else slab->cache->partial = slab->next;
+	if(slab->next != NULL) slab->next->prev = slab->prev;
+	slab->prev = NULL;
+	slab->next = NULL;
+}
+
+/* kmem_cache_alloc
+ *   DESCRIPTION: takes a free object from a cache
+ *   INPUT: cache - the cache
+ *   OUTPUT: the object (not cleared), NULL if no frame is left for a slab
+ */
+void* kmem_cache_alloc(kmem_cache_t* cache){
+	slab_t* slab;
+	void* obj;
+	uint32_t flags;
+
+	if(cache == NULL) return NULL;
+
+	cli_and_save(flags);
+	slab = cache->partial;
+	if(slab == NULL) slab = slab_grow(cache);
+	if(slab == NULL){
+		restore_flags(flags);
+		return NULL;
+	}
+
+	obj = slab->free_list;
+	slab->free_list = *(void**)obj;
+	if(++slab->in_use == cache->per_slab) slab_unlink(slab); // now full
+	cache->active++;
+	restore_flags(flags);
+	return obj;
+}
+
+/* kfree
+ *   DESCRIPTION: gives back an object of kmem_cache_alloc or kmalloc. A
+ *                slab that becomes empty goes back to the frame pool, unless
+ *                it is the only one with room left.
+ *   INPUT: obj - the object, NULL is ignored
+ *   OUTPUT: none
+ */
+void kfree(void* obj){
+	slab_t* slab = (slab_t*)((uint32_t)obj & FRAME_MASK);
+	kmem_cache_t* cache;
+	uint32_t flags;
+
+	if(obj == NULL) return;
+	if((void*)slab == obj){
+		put_user_frame((uint32_t)obj); // a frame of its own (big kmalloc)
+		return;
+	}
+
+	cli_and_save(flags);
+	cache = slab->cache;
+	*(void**)obj = slab->free_list;
+	slab->free_list = obj;
+	cache->active--;
+
+	if(slab->in_use-- == cache->per_slab){
+		/* was full: back on the partial list */
+		slab->prev = NULL;
+		slab->next = cache->partial;
+		if(cache->partial != NULL) cache->partial->prev = slab;
+		cache->partial = slab;
+	}
+	if(slab->in_use == 0 && (cache->partial != slab || slab->next != NULL)){
+		slab_unlink(slab);
+		cache->slabs--;
+		put_user_frame((uint32_t)slab);
+	}
+	restore_flags(flags);
+}
+
+/* kmalloc
+ *   DESCRIPTION: takes size bytes from the smallest size class that fits,
+ *                or a whole frame past the biggest class
+ *   INPUT: size - bytes wanted, up to FRAME_SIZE
+ *   OUTPUT: the memory (not cleared), NULL if size is 0 or too big, or
+ *           memory ran out
+ */
+void* kmalloc(uint32_t size){
+	uint32_t i;
+
+	if(size == 0 || size > FRAME_SIZE) return NULL;
+
+	for(i = 0; i < KMALLOC_CLASSES; i++){
+		if(size <= (KMALLOC_MIN_SIZE << i)) return kmem_cache_alloc(kmalloc_caches[i]);
+	}
+	return (void*)alloc_user_frame();
+}
@@ -0,0 +1,48 @@
+/* slab.h - allocator for kernel objects
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "types.h"
+
+#define SLAB_MAX_CACHES		16 // caches kmem_cache_create can hand out
+#define KMALLOC_MIN_SIZE	16 // smallest kmalloc size class
+#define KMALLOC_CLASSES		8  // 16, 32, ... 2048 bytes
+
+struct kmem_cache_t;
+
+/* one frame of a cache; the header sits at the start of the frame, the
+ * objects after it */
+typedef struct slab_t{
+	struct slab_t* prev;		// neighbours on the cache's partial list
+	struct slab_t* next;
+	struct kmem_cache_t* cache;
+	void* free_list;			// free objects, linked through their first word
+	uint32_t in_use;			// objects handed out
+}slab_t;
+
+/* objects of one size. Slabs with free objects are on the partial list;
+ * full slabs are on no list, kfree finds them from the object address. */
+typedef struct kmem_cache_t{
+	const int8_t* name;
+	uint32_t obj_size;
+	uint32_t per_slab;			// objects in one slab
+	slab_t* partial;
+	uint32_t active;			// objects handed out
+	uint32_t slabs;				// frames held
+}kmem_cache_t;
+
+/* sets up the kmalloc size classes */
+void slab_init(void);
+/* makes a cache of objects of size bytes, NULL if none is left or too big */
+kmem_cache_t* kmem_cache_create(const int8_t* name, uint32_t size);
+/* takes an object from a cache, NULL if memory ran out */
+void* kmem_cache_alloc(kmem_cache_t* cache);
+/* gives back an object of kmem_cache_alloc or kmalloc */
+void kfree(void* obj);
+/* takes size bytes (up to a frame), NULL if memory ran out */
+void* kmalloc(uint32_t size);
+
+#endif /* SLAB_H */
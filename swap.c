@@ -0,0 +1,116 @@
+/* swap.c - swap area on a disk partition
+ * vim:ts=4 noexpandtab
+ *
+ * The first partition of type 0x82 on the primary disk is cut into 4KB
+ * slots. Which pages go out, and when, is up to paging.c; this only hands
+ * out slots and moves pages in and out of them. A slot is reference counted
+ * like a frame, since fork copies page table entries that point at it.
+ */
+
+#include "swap.h"
+#include "ata.h"
+#include "lib.h"
+#include "paging.h"
+
+#define SECTORS_PER_SLOT	(FRAME_SIZE / ATA_SECTOR_SIZE)
+
+static uint8_t swap_map[SWAP_MAX_SLOTS]; // reference count of every slot, 0 = free
+static uint32_t swap_start = 0;          // first sector of the partition
+static uint32_t swap_slots = 0;          // 0 while swap is off
+static uint32_t next_swap_slot = 0;      // next-fit hint for swap_alloc
+
+/* swap_init
+ *   DESCRIPTION: looks for a swap partition in the primary disk's MBR
+ *   INPUT: none
+ *   OUTPUT: number of 4KB slots, 0 if there is no disk or no swap partition
+ *           (swap stays off)
+ */
+uint32_t swap_init(void){
+	uint8_t mbr[ATA_SECTOR_SIZE];
+	mbr_part_t* part;
+	int i;
+
+	if(!ata_init() || ata_read(0, 1, mbr) == -1) return 0;
+	if(*(uint16_t*)(mbr + MBR_SIGNATURE) != MBR_SIGNATURE_VAL) return 0;
+
+	part = (mbr_part_t*)(mbr + MBR_PART_TABLE);
+	for(i = 0; i < MBR_PART_NUM; i++, part++){
+		if(part->type != SWAP_PART_TYPE) continue;
+		swap_start = part->lba_first;
+		swap_slots = part->sectors / SECTORS_PER_SLOT;
+		if(swap_slots > SWAP_MAX_SLOTS) swap_slots = SWAP_MAX_SLOTS;
+		return swap_slots;
+	}
+	return 0;
+}
+
+/* swap_alloc
+ *   DESCRIPTION: takes a free slot
+ *   INPUT: none
+ *   OUTPUT: the slot, -1 if swap is off or every slot is in use
+ *   SIDE EFFECTS: slot's reference count becomes 1
+ */
+int32_t swap_alloc(void){
+	uint32_t i, slot;
+
+	for(i = 0; i < swap_slots; i++){
+		slot = (next_swap_slot + i) % swap_slots;
+		if(swap_map[slot] == 0){
+			swap_map[slot] = 1;
+			next_swap_slot = (slot + 1) % swap_slots;
+			return slot;
+		}
+	}
+	return -1;
+}
+
+/* swap_dup
+ *   DESCRIPTION: adds a reference to a slot that is being shared (fork)
+ *   INPUT: slot - the slot
+ *   OUTPUT: none
+ */
+void swap_dup(uint32_t slot){
+	if(slot < swap_slots && swap_map[slot] < SWAP_COUNT_MAX) swap_map[slot]++;
+}
+
+/* swap_free
+ *   DESCRIPTION: drops a reference to a slot; it is free again once nobody
+ *                references it
+ *   INPUT: slot - the slot
+ *   OUTPUT: none
+ */
+void swap_free(uint32_t slot){
+	if(slot < swap_slots && swap_map[slot] > 0) swap_map[slot]--;
+}
+
+/* swap_count
+ *   DESCRIPTION: number of references to a slot
+ *   INPUT: slot - the slot
+ *   OUTPUT: the count
+ */
+uint32_t swap_count(uint32_t slot){
+	if(slot >= swap_slots) return 0;
+	return swap_map[slot];
+}
+
+/* swap_read
+ *   DESCRIPTION: reads a page back from its slot
+ *   INPUT: slot - the slot
+ *          frame_addr - physical (= kernel virtual) address of the frame to fill
+ *   OUTPUT: 0 on success, -1 on a disk error
+ */
+int32_t swap_read(uint32_t slot, uint32_t frame_addr){
+	if(slot >= swap_slots) return -1;
+	return ata_read(swap_start + slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT, (void*)frame_addr);
+}
+
+/* swap_write
+ *   DESCRIPTION: writes a page out to a slot
+ *   INPUT: slot - the slot
+ *          frame_addr - physical (= kernel virtual) address of the frame
+ *   OUTPUT: 0 on success, -1 on a disk error
+ */
+int32_t swap_write(uint32_t slot, uint32_t frame_addr){
+	if(slot >= swap_slots) return -1;
+	return ata_write(swap_start + slot * SECTORS_PER_SLOT, SECTORS_PER_SLOT, (const void*)frame_addr);
+}
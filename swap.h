@@ -0,0 +1,40 @@
+/* swap.h - swap area on a disk partition
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef SWAP_H
+#define SWAP_H
+
+#include "types.h"
+
+#define SWAP_PART_TYPE		0x82 // MBR partition type of a swap area
+#define MBR_PART_TABLE		0x1BE
+#define MBR_PART_NUM		4
+#define MBR_SIGNATURE		0x1FE
+#define MBR_SIGNATURE_VAL	0xAA55
+#define SWAP_MAX_SLOTS		32768 // 4KB slots: up to 128MB of swap is used
+#define SWAP_COUNT_MAX		0xFF
+
+/* one entry of the MBR partition table */
+typedef struct mbr_part_t{
+	uint8_t status;
+	uint8_t chs_first[3];
+	uint8_t type;
+	uint8_t chs_last[3];
+	uint32_t lba_first;
+	uint32_t sectors;
+}__attribute__ ((packed)) mbr_part_t;
+
+/* finds the swap partition; number of slots in it, 0 without one */
+uint32_t swap_init(void);
+/* takes a free slot; -1 if swap is off or full */
+int32_t swap_alloc(void);
+/* reference counts of slots, one per page table entry (or frame) holding it */
+void swap_dup(uint32_t slot);
+void swap_free(uint32_t slot);
+uint32_t swap_count(uint32_t slot);
+/* move a page between a frame and a slot */
+int32_t swap_read(uint32_t slot, uint32_t frame_addr);
+int32_t swap_write(uint32_t slot, uint32_t frame_addr);
+
+#endif /* SWAP_H */
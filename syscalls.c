@@ -11,20 +11,32 @@
 #include "keyboard.h"
 #include "isr_wrapper.h"
 #include "x86_desc.h"
+#include "sched.h"
+#include "pipe.h"
+#include "shm.h"
+#include "signal.h"
+#include "poll.h"
+#include "trace.h"
+#include "futex.h"
+#include "slab.h"
 
 /* file-scope variables used as buffers mostly, to pass info between the functions/steps of execute */
 const uint8_t* command_buf;
 int i, size_of_args;
 uint32_t command_len;
-uint8_t available_pid;
-/* array of pid status */
-static uint8_t pid_bits[MAX_PROCESS_NUM];
+pcb_t* available_pcb;
+/* bitmap of pid status, bit set = pid in use */
+static uint32_t pid_bits[MAX_PROCESS_NUM / 32];
+/* next-fit hint for alloc_process */
+static uint32_t next_pid = 0;
+/* spilled file descriptor tables, FD_MAX_NUM entries each */
+static kmem_cache_t* fd_table_cache = NULL;
 /* predefined function operations table */
 fops_table file_ftable = {(open_t)file_open, (close_t)file_close, (read_t)file_read, (write_t)file_write};
 fops_table dir_ftable = {(open_t)dir_open, (close_t)dir_close, (read_t)dir_read, (write_t)dir_write};
-fops_table rtc_ftable = {(open_t)rtc_open, (close_t)rtc_close, (read_t)rtc_read, (write_t)rtc_write};
-fops_table stdin_ftable = {NULL, NULL, (read_t)terminal_read, NULL};
-fops_table stdout_ftable = {NULL, NULL, NULL, (write_t)terminal_write};
+fops_table rtc_ftable = {(open_t)rtc_open, (close_t)rtc_close, (read_t)rtc_read, (write_t)rtc_write, (poll_t)rtc_poll};
+fops_table stdin_ftable = {NULL, NULL, (read_t)terminal_read, NULL, (poll_t)terminal_poll};
+fops_table stdout_ftable = {NULL, NULL, NULL, (write_t)terminal_write, (poll_t)terminal_poll};
 
 
 /* get_curr_pcb
@@ -46,6 +58,65 @@ void* get_curr_pcb(void){
 	return (void*)(esp & PCB_CALC_OFFSET);
 }
 
+/* get_curr_proc
+ *   DESCRIPTION: gets the pcb holding the resources (files, memory, heap,
+ *                signal handlers) of the current thread's process
+ *   INPUT: none
+ *	 OUTPUT: the leader of the current thread
+ */
+pcb_t* get_curr_proc(void){
+	return ((pcb_t*)get_curr_pcb())->leader;
+}
+
+/* alloc_process
+ *   DESCRIPTION: finds a free pid and marks it as used, and gets a kernel
+ *                stack from the frame pool with a zeroed pcb at its bottom
+ *   INPUT: none
+ *	 OUTPUT: the new pcb (only pid filled in), NULL if no pid or memory left
+ */
+pcb_t* alloc_process(void){
+	uint32_t j, pid;
+	pcb_t* pcb;
+
+	for(j = 0; j < MAX_PROCESS_NUM; j++){
+		pid = (next_pid + j) % MAX_PROCESS_NUM;
+		if(!(pid_bits[pid >> 5] & (1 << (pid & 31)))) break;
+	}
+	// if max process reached, ret NULL
+	if(j == MAX_PROCESS_NUM) return NULL;
+
+	pcb = (pcb_t*)alloc_kernel_stack();
+	if(pcb == NULL) return NULL;
+
+	pid_bits[pid >> 5] |= (1 << (pid & 31));
+	next_pid = (pid + 1) % MAX_PROCESS_NUM;
+	memset(pcb, 0, sizeof(pcb_t));
+	pcb->pid = pid;
+	pcb->leader = pcb;
+	return pcb;
+}
+
+/* free_process
+ *   DESCRIPTION: gives a pid and its kernel stack back. Also used on the
+ *                stack being freed: that is fine as long as interrupts stay
+ *                off until we switch away, since nothing reuses it before.
+ *   INPUT: pcb - the process
+ *	 OUTPUT: none
+ */
+void free_process(pcb_t* pcb){
+	free_pid(pcb);
+	free_kernel_stack((uint32_t)pcb);
+}
+
+/* free_pid
+ *   DESCRIPTION: gives back the pid of a process, keeping its pcb and stack
+ *   INPUT: pcb - the process
+ *	 OUTPUT: none
+ */
+void free_pid(pcb_t* pcb){
+	pid_bits[pcb->pid >> 5] &= ~(1 << (pcb->pid & 31));
+}
+
 /* halt
  *   DESCRIPTION: halt gets rid of the process from the memory except for the first shell
  *   INPUT: status : tells if the halt has executed successfully
@@ -54,15 +125,35 @@ void* get_curr_pcb(void){
  *	 SIDE EFFECTS: erases paging for the process that is halted, goes back to the parent's page
  */
 int32_t halt(uint8_t status){
+	cli();
 
 	/* step 1: restore parent data */
 	pcb_t * current_pcb = get_curr_pcb();
 	pcb_t * parent_pcb = (pcb_t*)(current_pcb->parent);
+
+	// a thread ends alone; its process ends with the first thread
+	if(current_pcb->leader != current_pcb){
+		halt_thread(current_pcb);
+	}
+	kill_threads(current_pcb);
+
+	// started by spawn/fork: nobody is held for us, leave a zombie for wait
+	if(current_pcb->spawned){
+		halt_spawned(current_pcb, status);
+	}
+
 	tss.esp0 = current_pcb->esp0;
 
 	// if closing from root shell, clear everything and start a new shell
 	if(parent_pcb == NULL) {
-		tss.esp0 = KERNEL_STACK_START - KERNEL_STACK_SIZE * (current_pcb->pid) - sizeof(void * );
+		close_all_fds(current_pcb);
+		// the address space is kept, so give back what exit would free with it
+		shm_detach_all(current_pcb);
+		resize_process_heap(&current_pcb->mem, current_pcb->heap_end, USER_HEAP_START);
+		current_pcb->heap_end = USER_HEAP_START;
+		current_pcb->sig_pending = 0;
+		current_pcb->sig_masked = 0;
+		tss.esp0 = KERNEL_STACK_TOP(current_pcb);
 
 		// retrieve eflags and set IF = 1
 		uint32_t eflags = 0;
@@ -96,20 +187,21 @@ int32_t halt(uint8_t status){
 
 
 	/* step 2: restore parent paging */
-	pid_bits[current_pcb->pid] = 0; // set pid to available
-	free_process_memory(current_pcb->pid); // free current process page
-	set_process_memory(parent_pcb->pid);	 // set current page to parent's
+	orphan_children(current_pcb);
+	sched_remove(current_pcb);
+	shm_detach_all(current_pcb);
+	parent_pcb->state = PROC_RUNNABLE; // parent is no longer held in execute
+	free_process_memory(&current_pcb->mem); // free current process page
+	set_process_memory(&parent_pcb->mem);	 // set current page to parent's
 
 	terminal_arr[terminal_num].most_recent_pcb = parent_pcb;
 
 	/* step 3: close any relevant FD's */
-	int i;
-  for(i=0; i<FD_ARRAY_SIZE; ++i){
-    current_pcb->fd_array[i].fxn_tbl_ptr =  NULL;
-    current_pcb->fd_array[i].inode = 0;
-    current_pcb->fd_array[i].file_pos = 0;
-    current_pcb->fd_array[i].flags = 0;
-  }
+	close_all_fds(current_pcb);
+	free_fd_table(current_pcb);
+
+	// set pid and kernel stack to available; still on it until the jump below
+	free_process(current_pcb);
 
 	/* step 4: Jump to Execute Return */
 	uint32_t new_status = status;
@@ -143,40 +235,24 @@ int32_t halt(uint8_t status){
 int32_t execute(const uint8_t* command){
 	cli();
 
-	command_buf = command;
-	command_len = strlen((const int8_t*)command_buf);
-	uint8_t fname[command_len+1]; // name of the executable
-	uint8_t args[command_len+1];
-	memset(fname,'\0',command_len+1); // clear buf
-	memset(args,'\0',command_len+1); // clear buf
-
-  /* step 1. parse arguments */
-	/* step 2. check to see if valid executable */
-  /* step 3. set pid bit and allocate page */
-	if(execute_setup(args, fname) == -1) return -1;
-
-  /* step 4. load the filedata into the allocated page */
-	// read file content into corresponding phys addr
-	if(read_data(opened_file.inode_num, 0, (uint8_t*)FILE_LOCATION, PAGE_SIZE)==-1)
+	// a thread can't be held in execute, its process may end under it
+	pcb_t* current_pcb = get_running_pcb();
+	if(current_pcb != NULL && current_pcb->leader != current_pcb &&
+	   terminal_arr[terminal_num].active == ON)
+		return -1;
+	// a program's command must be in user space; the kernel passes its own
+	// string only when it starts a terminal's first shell
+	if(terminal_arr[terminal_num].active == ON &&
+	   (command == NULL || bad_userspace_addr(command, COMMAND_SIZE)))
 		return -1;
 
-  /* step 5. create pcb and populate it */
-	pcb_t* pcb_new = (pcb_t*)(KERNEL_STACK_START - KERNEL_STACK_SIZE * (available_pid + 1));
-	execute_fillpcb(pcb_new);
-	if(terminal_arr[terminal_num].active == OFF){
-		terminal_arr[terminal_num].active = ON;
-		pcb_new->parent = NULL;
-		pcb_new->tid = terminal_num;
-	}
-	else{
-		pcb_new->parent = (pcb_t*)get_curr_pcb();
-		pcb_new->tid = pcb_new->parent->tid;
-	}
-	terminal_arr[terminal_num].most_recent_pcb = pcb_new;
+  /* steps 1 ~ 5. parse, check, allocate page, load file, create pcb */
+	pcb_t* pcb_new = execute_load(command);
+	if(pcb_new == NULL) return -1;
 
-	// set args
-	strcpy((int8_t*)pcb_new->args, (int8_t*)&(args));
-	pcb_new->args_size = size_of_args;
+	terminal_arr[terminal_num].most_recent_pcb = pcb_new;
+	if(pcb_new->parent != NULL)
+		pcb_new->parent->state = PROC_EXECUTING; // held until the child halts
 
   /* set bookkeeping info: parent, esp0, ss0, esp, ebp, eip and args */
   //save ebp
@@ -187,10 +263,7 @@ int32_t execute(const uint8_t* command){
 
 	// set tss values; note: tss is always current
 	pcb_new->esp0 = tss.esp0; // saving old esp0 into our new pcb
-	tss.esp0 = KERNEL_STACK_START - KERNEL_STACK_SIZE * (pcb_new->pid) - sizeof(void * ); //
-  pcb_new->esp = VIRTUAL_ADDR_START + USER_SPACE_SIZE - sizeof(void *);
-  // set executable code's eip to pcb's eip
-  read_data(opened_file.inode_num, EIP_ADDR_OFFSET, (uint8_t*)(&(pcb_new->eip)), EIP_ADDR_SIZE); // 24~27B holds eip
+	tss.esp0 = KERNEL_STACK_TOP(pcb_new); //
 
   /* step 6. context switch */
 	execute_cswitch(pcb_new);
@@ -210,13 +283,17 @@ int32_t execute(const uint8_t* command){
  */
 int32_t read(int32_t fd, void* buf, int32_t nbytes){
 
-  pcb_t* current_pcb = get_curr_pcb(); // replace function by getting current_pcb function
+  pcb_t* current_pcb = get_curr_proc(); // files belong to the process
 
   int32_t ret;
 
 	/* if fd is invalid number, or stdout, or if the file doesn't exist
 	 * read is unsucceesful */
-  if (fd < 0 || fd >= FD_ARRAY_SIZE || fd == 1 || current_pcb->fd_array[fd].flags == 0){
+  if (fd == 1 || !fd_is_open(current_pcb, fd)){
+    return -1;
+  }
+  /* buf must be user memory; the file's read copies into it fault safely */
+  if (bad_userspace_addr(buf, nbytes)){
     return -1;
   }
   /* read == number of bytes if successful, -1 is unsucessful */
@@ -237,18 +314,20 @@ int32_t read(int32_t fd, void* buf, int32_t nbytes){
  */
 int32_t write(int32_t fd, const void* buf, int32_t nbytes){
 
-  pcb_t* current_pcb = get_curr_pcb(); // replace function by getting current_pcb function
+  pcb_t* current_pcb = get_curr_proc(); // files belong to the process
 
   int32_t ret;
 
 	/* if fd is invalid number, or stdin, or if the file doesn't exist
 	 * write is unsucceesful */
-  if (fd < 0 || fd >= FD_ARRAY_SIZE || fd == 0 || current_pcb->fd_array[fd].flags == 0){
+  if (fd == 0 || !fd_is_open(current_pcb, fd)){
     return -1;
   }
 
-  /* check if something is other than terminal write or rtc write */
-  // insert code for the check
+  /* buf must be user memory; the file's write copies from it fault safely */
+  if (bad_userspace_addr(buf, nbytes)){
+    return -1;
+  }
 
   /* ret == 0 if successful, -1 if unsuceesful */
   ret = current_pcb->fd_array[fd].fxn_tbl_ptr->write(fd, buf, nbytes);
@@ -268,31 +347,45 @@ int32_t open(const uint8_t* filename){
   // int32_t pid = function(); // get current pid, replace function() with get current pid function
   // pcb_t* current_pcb = EIGHT_MEGA - FOUR_KILO*pid - 4;
 
+	/* copy the name in (one char past the longest name, so too long names
+	 * still fail below); everything after this works on the kernel copy */
+	uint8_t name[FILENAME_SIZE + 2];
+	if(filename == NULL || bad_userspace_addr(filename, 1) ||
+	   safe_strncpy((int8_t*)name, (const int8_t*)filename, FILENAME_SIZE + 1) == -1)
+		return -1;
+	name[FILENAME_SIZE + 1] = '\0';
+	filename = name;
+
 	/* if file name is invalid, open is unsuceesful */
 	if(filename == NULL || filename[0] == '\0' || filename[0] == ' ' ||
 		 filename == ((uint8_t*)""))
 		return -1;
 
-  pcb_t* current_pcb = get_curr_pcb(); // replace function by getting current_pcb function
+  pcb_t* current_pcb = get_curr_proc(); // files belong to the process
 
 	/* dentry to load */
   dentry_t current_dentry;
 
+	/* kernel devices that aren't in the file system image */
+  if (strncmp((int8_t*)filename, (int8_t*)TRACE_DEVICE_NAME, FILENAME_SIZE) == 0){
+    int fd = alloc_fd(current_pcb);
+    if (fd == -1) return -1;
+    current_pcb->fd_array[fd].fxn_tbl_ptr = &trace_ftable;
+    current_pcb->fd_array[fd].inode = 0; // device doesn't have inode
+    current_pcb->fd_array[fd].file_pos = 0;
+    current_pcb->fd_array[fd].flags = 1; // the file descriptor entry is occupied
+    return fd;
+  }
+
 	/* read the entry by name */
   if (read_dentry_by_name(filename, &current_dentry) == -1){
     return -1;
   }
 
-  int i; // iterator
-
   /* find empty file */
-  for (i = FIRST_AVAILABLE_FD; i < FD_ARRAY_SIZE; i ++){
-    if (current_pcb->fd_array[i].flags == 0){ // empty file
-      break;
-    }
-  }
+  int i = alloc_fd(current_pcb);
 
-  if (i == FD_ARRAY_SIZE) return -1; // if the files are full, return -1
+  if (i == -1) return -1; // if the files are full, return -1
 
 	/* different fops pointer depending on the filetype
 	 * filetype 0: rtc
@@ -328,9 +421,11 @@ int32_t open(const uint8_t* filename){
 			size_of_filename = size_of_filename + 1;
 		}
 
-		if(size_of_filename != size_of_dentry_filename) return -1;
-
-		if(strncmp((int8_t*)current_dentry.filename,(int8_t*)filename,size_of_filename) !=0) return -1; // null check
+		if(size_of_filename != size_of_dentry_filename ||
+		   strncmp((int8_t*)current_dentry.filename,(int8_t*)filename,size_of_filename) !=0){ // null check
+			release_fd(current_pcb, i);
+			return -1;
+		}
 
     current_pcb->fd_array[i].fxn_tbl_ptr = &file_ftable; // file doesn't have inode
     current_pcb->fd_array[i].inode = current_dentry.inode_num; // file has inode number
@@ -338,6 +433,7 @@ int32_t open(const uint8_t* filename){
     current_pcb->fd_array[i].flags = 1; // the file descriptor entry is occupied
   }
   else{
+    release_fd(current_pcb, i);
     return -1; // if filetype is invalid, read is unsucessful.
   }
 
@@ -353,16 +449,18 @@ int32_t open(const uint8_t* filename){
  */
 int32_t close(int32_t fd){
 
-  if (fd < 2 || fd >= FD_ARRAY_SIZE){
+  if (fd < 2){
     return -1; // if trying to close default descriptors or invalid descriptiors, fail
   }
 
-  pcb_t* current_pcb = get_curr_pcb(); // replace function by getting current_pcb function
+  pcb_t* current_pcb = get_curr_proc(); // files belong to the process
 
-	if(current_pcb->fd_array[fd].flags == 0){	//means it is unopened
+	if(!fd_is_open(current_pcb, fd)){	//means it is unopened
 		return -1;
 	}
-  current_pcb->fd_array[fd].flags = 0; // file decriptor is now free to be occupied
+	if(current_pcb->fd_array[fd].fxn_tbl_ptr->close != NULL)
+		current_pcb->fd_array[fd].fxn_tbl_ptr->close(fd); // e.g. drop a pipe end
+  release_fd(current_pcb, fd); // file decriptor is now free to be occupied
 
   return 0; // close was succesful
 }
@@ -375,14 +473,17 @@ int32_t close(int32_t fd){
  */
 int32_t getargs(uint8_t* buf, int32_t nbytes){
 	/* pcb saves the args when new process is created; thus, fetch it */
-	pcb_t* current_pcb = get_curr_pcb();
+	pcb_t* current_pcb = get_curr_proc();
 
 	/* if no args or args is longer than required, fail it */
-	if(current_pcb->args_size == 0 || current_pcb->args_size > nbytes)
+	if(current_pcb->args_size == 0 || current_pcb->args_size > nbytes ||
+	   bad_userspace_addr(buf, nbytes))
   	return -1;
 	else{
-		/* copy the args into buf */
-		strncpy((int8_t*)buf,(int8_t*)(current_pcb->args),nbytes);
+		/* copy the args into buf, zero filling the rest like strncpy */
+		if(copy_to_user(buf, current_pcb->args, current_pcb->args_size) != 0 ||
+		   clear_user(buf + current_pcb->args_size, nbytes - current_pcb->args_size) != 0)
+			return -1;
 		return 0;
 	}
 }
@@ -393,11 +494,8 @@ int32_t getargs(uint8_t* buf, int32_t nbytes){
  *	 OUTPUT: -1 indicates fail, otherwise holds the virtual video address
  */
 int32_t vidmap(uint8_t** screen_start){
-	int32_t start_address = (int32_t)(screen_start);
-
-	/* ensure that the start addr is in 128~132 MB, aka correct pg*/
-	if (start_address < FILE_LOCATION || start_address >= (FILE_LOCATION + PAGE_SIZE)){
-		return -1;	//check that given address of screen_start is located in correct page
+	if (bad_userspace_addr(screen_start, sizeof(uint8_t*))){
+		return -1;	//screen_start must be user memory
 	}
 
 
@@ -405,24 +503,635 @@ int32_t vidmap(uint8_t** screen_start){
 	//int32_t virtual_address = VIRTUAL_VIDEO_ADDRESS;
 	uint8_t * virtual_address = (uint8_t *)(terminal_arr[((pcb_t *)get_curr_pcb())->tid].vidmem_addr);
 	/* copy the addr into screen_start */
-	*screen_start = virtual_address;
+	if (copy_to_user(screen_start, &virtual_address, sizeof(uint8_t*)) != 0){
+		return -1;
+	}
   return (int32_t)virtual_address;
 }
 
 
-/* Function implemented for signaling for extra credit, but not implemented */
+/* set_handler
+ *   DESCRIPTION: sets the user level handler of a signal (see signal.h)
+ *   INPUT: signum - signal number
+ *          handler_address - handler, called with signum as its argument;
+ *                            NULL restores the default action
+ *	 OUTPUT: 0 on success, -1 if signum is bad
+ *	 SIDE EFFECTS: none
+ */
 int32_t set_handler(int32_t signum, void* handler_address){
-  return -1;
+	pcb_t * current_pcb = get_curr_proc(); // shared by the threads
+
+	if(signum < 0 || signum >= NUM_SIGNALS) return -1;
+	current_pcb->sig_handler[signum] = handler_address;
+	return 0;
 }
 
-/* Function implemented for signaling for extra credit, but not implemented */
+/* sigreturn
+ *   DESCRIPTION: called by the trampoline a signal handler returns to; puts
+ *                back the user context saved below the trampoline when the
+ *                signal was delivered (see signal.c)
+ *   INPUT: none
+ *	 OUTPUT: -1 if there is no valid saved context; otherwise does not
+ *           return here, the interrupted code resumes with all of its
+ *           registers, eax included
+ *	 SIDE EFFECTS: rewrites the system call frame, unmasks signals
+ */
 int32_t sigreturn(void){
-  return -1;
+	pcb_t * current_pcb = get_curr_pcb();
+	uint32_t * frame = (uint32_t*)tss.esp0 - SYSCALL_FRAME_SIZE;
+	sig_context_t * user_ctx = (sig_context_t*)(frame[SYSCALL_FRAME_ESP] + sizeof(uint32_t)); // above signum
+	sig_context_t saved;
+	sig_context_t * ctx = &saved;
+
+	if(!current_pcb->sig_masked || bad_userspace_addr(user_ctx, sizeof(sig_context_t)) ||
+	   copy_from_user(ctx, user_ctx, sizeof(sig_context_t)) != 0)
+		return -1;
+
+	frame[SYSCALL_FRAME_EBX] = ctx->ebx;
+	frame[SYSCALL_FRAME_ECX] = ctx->ecx;
+	frame[SYSCALL_FRAME_EDX] = ctx->edx;
+	frame[SYSCALL_FRAME_ESI] = ctx->esi;
+	frame[SYSCALL_FRAME_EDI] = ctx->edi;
+	frame[SYSCALL_FRAME_EBP] = ctx->ebp;
+	frame[SYSCALL_FRAME_EIP] = ctx->eip;
+	frame[SYSCALL_FRAME_ESP] = ctx->esp;
+	// only the arithmetic flags are the handler's to change
+	frame[SYSCALL_FRAME_EFLAGS] = (frame[SYSCALL_FRAME_EFLAGS] & ~SIG_EFLAGS_MASK) |
+	                              (ctx->eflags & SIG_EFLAGS_MASK) | EFLAGS_IF_MASK;
+	current_pcb->sig_masked = 0;
+
+	/* unwind straight from the frame; eax is the user's, not a return code */
+	asm volatile(
+			"movl %0, %%esp;"
+			"movl %1, %%eax;"
+			"jmp SYSCALL_RETURN;"
+			:
+			: "r"(frame), "r"(ctx->eax)
+			);
+	return -1;
+}
+
+/* fork
+ *   DESCRIPTION: duplicates the calling process. The child's pcb is a copy of
+ *                the parent's, and its page table shares every user page
+ *                copy-on-write (see fork_process_memory), so forking costs a
+ *                page table instead of a 4MB copy.
+ *   INPUT: none
+ *	 OUTPUT: -1 if unsuccessful
+ *           0 in the child, the child's pid in the parent
+ *	 SIDE EFFECTS: claims a pid, write-protects the parent's pages and makes
+ *                 the child runnable
+ */
+int32_t fork(void){
+	cli();
+
+	pcb_t* parent_pcb = get_curr_pcb();
+	pcb_t* proc = parent_pcb->leader; // a thread forks its whole process
+	pcb_t* child_pcb = alloc_process();
+	if(child_pcb == NULL) return -1;
+	uint32_t child_pid = child_pcb->pid;
+
+	/* child pcb starts as a copy of the process's: same files, args,
+	 * terminal; it has only the calling thread */
+	memcpy(child_pcb, proc, sizeof(pcb_t));
+	child_pcb->pid = child_pid;
+	child_pcb->leader = child_pcb;
+	child_pcb->parent = proc; // any thread's wait can collect it
+	child_pcb->spawned = 1;
+	child_pcb->group_exit = 0;
+	child_pcb->poll_table = NULL;
+	child_pcb->sig_pending = 0;
+	child_pcb->sig_masked = parent_pcb->sig_masked; // same frame, maybe in a handler
+
+	if(copy_fd_table(child_pcb, proc) == -1){
+		free_process(child_pcb);
+		return -1;
+	}
+	if(fork_process_memory(&proc->mem, &child_pcb->mem) == -1){
+		free_fd_table(child_pcb);
+		free_process(child_pcb);
+		return -1;
+	}
+	pipe_dup_fds(child_pcb); // child shares the parent's pipe ends
+	shm_dup(child_pcb->shm_mask); // and its shared memory mappings
+
+	/* copy the parent's syscall frame to the top of the child's kernel stack;
+	 * tss.esp0 is the top of the parent's stack while it is in a syscall */
+	uint32_t* child_frame = (uint32_t*)KERNEL_STACK_TOP(child_pcb) - SYSCALL_FRAME_SIZE;
+	memcpy(child_frame, (uint32_t*)tss.esp0 - SYSCALL_FRAME_SIZE, SYSCALL_FRAME_SIZE * sizeof(uint32_t));
+
+	/* the child first runs by unwinding that frame, returning 0 */
+	init_child_context(child_pcb, child_frame);
+	sched_add(child_pcb);
+
+	return child_pid;
+}
+
+/* spawn
+ *   DESCRIPTION: loads a program like execute, but the parent keeps running;
+ *                the child is left runnable and starts on its next timeslice
+ *   INPUT: command: filename of the executable and the arguments of the command
+ *	 OUTPUT: -1 if unsuccessful
+ *           pid of the child if successful
+ *	 SIDE EFFECTS: sets up paging and a pcb for the child
+ */
+int32_t spawn(const uint8_t* command){
+	cli();
+
+	if(command == NULL || bad_userspace_addr(command, COMMAND_SIZE)) return -1;
+
+	pcb_t* parent_pcb = get_curr_pcb();
+	pcb_t* pcb_new = execute_load(command);
+	if(pcb_new == NULL) return -1;
+	pcb_new->spawned = 1;
+	pcb_new->parent = parent_pcb->leader; // child of the process, not the thread
+
+	/* first context: a syscall frame that "returns" to the program's entry */
+	uint32_t* frame = (uint32_t*)KERNEL_STACK_TOP(pcb_new) - SYSCALL_FRAME_SIZE;
+	memset(frame, 0, SYSCALL_FRAME_SIZE * sizeof(uint32_t));
+	frame[SYSCALL_FRAME_FS] = USER_DS;
+	frame[SYSCALL_FRAME_ES] = USER_DS;
+	frame[SYSCALL_FRAME_DS] = USER_DS;
+	frame[SYSCALL_FRAME_EIP] = pcb_new->eip;
+	frame[SYSCALL_FRAME_CS] = USER_CS;
+	frame[SYSCALL_FRAME_EFLAGS] = EFLAGS_IF_MASK;
+	frame[SYSCALL_FRAME_ESP] = pcb_new->esp;
+	frame[SYSCALL_FRAME_SS] = USER_DS;
+	init_child_context(pcb_new, frame);
+
+	// execute_load left the child's page loaded
+	set_process_memory(&parent_pcb->leader->mem);
+
+	return pcb_new->pid;
+}
+
+/* wait
+ *   DESCRIPTION: waits for any spawned/forked child to halt
+ *   INPUT: status - where to store the child's halt status, may be NULL
+ *	 OUTPUT: pid of the child, -1 if there is no child to wait for
+ */
+int32_t wait(int32_t* status){
+	return waitpid(-1, status);
+}
+
+/* waitpid
+ *   DESCRIPTION: blocks until the given spawned/forked child (any child if
+ *                pid is -1) halts, then collects it
+ *   INPUT: pid - child to wait for, -1 for any
+ *          status - where to store the child's halt status, may be NULL
+ *	 OUTPUT: pid of the collected child, -1 if there is no such child or
+ *           status is not a writable user address
+ *	 SIDE EFFECTS: frees the child's pid; may sleep
+ */
+int32_t waitpid(int32_t pid, int32_t* status){
+	int32_t child_pid;
+	uint8_t found;
+	pcb_t* child;
+	pcb_t* current_pcb = get_curr_proc(); // children belong to the process
+
+	if(status != NULL && bad_userspace_addr(status, sizeof(int32_t))) return -1;
+
+	cli();
+	while(1){
+		found = 0;
+		for(child = process_list; child != NULL; child = child->next_proc){
+			if(child->parent != current_pcb || !child->spawned ||
+			   (pid != -1 && child->pid != pid))
+				continue;
+
+			found = 1;
+			if(child->state == PROC_ZOMBIE){
+				child_pid = child->pid;
+				// not collected if status can't be written; a retry still can
+				if(status != NULL &&
+				   copy_to_user(status, &child->exit_status, sizeof(int32_t)) != 0)
+					return -1;
+				reap_process(child);
+				return child_pid;
+			}
+		}
+		if(!found) return -1;
+
+		// woken up by halt_spawned of one of our children
+		sleep_on(current_pcb);
+	}
+}
+
+/* pipe
+ *   DESCRIPTION: creates a pipe and opens both of its ends
+ *   INPUT: fds - fds[0] gets the read end, fds[1] the write end
+ *	 OUTPUT: 0 if successful, -1 if fds is not a writable user address, two
+ *           file descriptors are not free or no memory is left for the pipe
+ */
+int32_t pipe(int32_t* fds){
+	int32_t ends[2];
+	pcb_t* current_pcb = get_curr_proc();
+
+	if(bad_userspace_addr(fds, 2 * sizeof(int32_t))) return -1;
+
+	/* find two empty files; both first, as the table may move when it grows */
+	ends[0] = alloc_fd(current_pcb);
+	if(ends[0] == -1) return -1;
+	ends[1] = alloc_fd(current_pcb);
+	if(ends[1] == -1 ||
+	   pipe_create(&current_pcb->fd_array[ends[0]], &current_pcb->fd_array[ends[1]]) == -1){
+		release_fd(current_pcb, ends[0]);
+		if(ends[1] != -1) release_fd(current_pcb, ends[1]);
+		return -1;
+	}
+
+	if(copy_to_user(fds, ends, 2 * sizeof(int32_t)) != 0){
+		close(ends[0]);
+		close(ends[1]);
+		return -1;
+	}
+	return 0;
+}
+
+/* shmat
+ *   DESCRIPTION: maps a named shared memory segment into the current process
+ *   INPUT: name - segment name
+ *          addr - page aligned address in the user page to map it at
+ *          size - bytes to map (size of the segment if it is created)
+ *	 OUTPUT: 0 if successful, -1 if unsuccessful
+ */
+int32_t shmat(const uint8_t* name, void* addr, int32_t size){
+	if(size <= 0) return -1;
+	if(shm_attach(name, (uint32_t)addr, (uint32_t)size) == -1) return -1;
+	return 0;
 }
 
+/* brk
+ *   DESCRIPTION: sets the program break of the current process
+ *   INPUT: addr - new break
+ *	 OUTPUT: 0 if successful, -1 if unsuccessful
+ *	 SIDE EFFECTS: maps or unmaps heap pages
+ */
+int32_t brk(void* addr){
+	pcb_t* current_pcb = get_curr_proc();
+	uint32_t new_end = (uint32_t)addr;
+
+	if(new_end < USER_HEAP_START || new_end > USER_HEAP_END) return -1;
+	if(resize_process_heap(&current_pcb->mem, current_pcb->heap_end, new_end) == -1) return -1;
 
+	current_pcb->heap_end = new_end;
+	return 0;
+}
+
+/* sbrk
+ *   DESCRIPTION: moves the program break of the current process
+ *   INPUT: increment - bytes to add to the heap (negative to give back)
+ *	 OUTPUT: the old break if successful, -1 if unsuccessful
+ *	 SIDE EFFECTS: maps or unmaps heap pages
+ */
+int32_t sbrk(int32_t increment){
+	pcb_t* current_pcb = get_curr_proc();
+	uint32_t old_end = current_pcb->heap_end;
 
+	/* bounds checked here so the sum can't wrap around */
+	if(increment > 0 && (uint32_t)increment > USER_HEAP_END - old_end) return -1;
+	if(increment < 0 && (uint32_t)(-increment) > old_end - USER_HEAP_START) return -1;
 
+	if(brk((void*)(old_end + increment)) == -1) return -1;
+	return old_end;
+}
+
+/* poll
+ *   DESCRIPTION: waits until one of several file descriptors is ready
+ *   INPUT: fds - array of pollfd_t in user memory
+ *          nfds - number of entries
+ *          timeout - ms to wait at most, 0 to not wait, -1 forever
+ *	 OUTPUT: number of ready entries, 0 on timeout, -1 if unsuccessful
+ *	 SIDE EFFECTS: may block the process
+ */
+int32_t poll(void* fds, uint32_t nfds, int32_t timeout){
+	if(fds == NULL || nfds > FD_MAX_NUM || timeout < -1 ||
+	   bad_userspace_addr(fds, nfds * sizeof(pollfd_t)))
+		return -1;
+	return poll_fds((pollfd_t*)fds, nfds, timeout);
+}
+
+/* clone
+ *   DESCRIPTION: starts a thread of the current process at entry(arg). Its
+ *                stack gets arg and a return address into a stub that halts
+ *                the thread with entry's return value.
+ *   INPUT: entry - user function to run
+ *          stack - top of the user memory set aside for the thread's stack
+ *          arg - argument passed to entry
+ *	 OUTPUT: pid of the thread, -1 if unsuccessful
+ *	 SIDE EFFECTS: the thread is runnable from its next timeslice
+ */
+int32_t clone(void* entry, void* stack, void* arg){
+	/* movl %eax, %ebx; movl $1, %eax; int $0x80 - halt(eax) */
+	static const uint8_t thread_exit[] = {0x89, 0xC3, 0xB8, 0x01, 0x00, 0x00, 0x00, 0xCD, 0x80};
+	uint32_t exit_addr = ((uint32_t)stack - sizeof(thread_exit)) & ~0x3;
+	uint32_t user_esp = exit_addr - 2 * sizeof(uint32_t);
+	uint32_t args[2] = {exit_addr, (uint32_t)arg}; // return address, arg
+	pcb_t* current_pcb = get_curr_pcb();
+	pcb_t* thread;
+
+	cli();
+	if(bad_userspace_addr(entry, 1) || bad_userspace_addr((void*)user_esp, (uint32_t)stack - user_esp) ||
+	   copy_to_user((void*)exit_addr, thread_exit, sizeof(thread_exit)) != 0 ||
+	   copy_to_user((void*)user_esp, args, sizeof(args)) != 0)
+		return -1;
+
+	thread = alloc_process();
+	if(thread == NULL) return -1;
+	thread->leader = current_pcb->leader;
+	thread->parent = NULL; // nobody waits for a thread, it reaps itself
+	thread->tid = current_pcb->tid;
+	thread->spawned = 1;
+
+	/* first context: a syscall frame that "returns" to entry */
+	uint32_t* frame = (uint32_t*)KERNEL_STACK_TOP(thread) - SYSCALL_FRAME_SIZE;
+	memset(frame, 0, SYSCALL_FRAME_SIZE * sizeof(uint32_t));
+	frame[SYSCALL_FRAME_FS] = USER_DS;
+	frame[SYSCALL_FRAME_ES] = USER_DS;
+	frame[SYSCALL_FRAME_DS] = USER_DS;
+	frame[SYSCALL_FRAME_EIP] = (uint32_t)entry;
+	frame[SYSCALL_FRAME_CS] = USER_CS;
+	frame[SYSCALL_FRAME_EFLAGS] = EFLAGS_IF_MASK;
+	frame[SYSCALL_FRAME_ESP] = user_esp;
+	frame[SYSCALL_FRAME_SS] = USER_DS;
+	init_child_context(thread, frame);
+	sched_add(thread);
+
+	return thread->pid;
+}
+
+/* futex
+ *   DESCRIPTION: waits on or wakes a word of user memory (see futex.h)
+ *   INPUT: addr - the word, 4 byte aligned
+ *          op - FUTEX_WAIT or FUTEX_WAKE
+ *          val - value expected for FUTEX_WAIT, waiters to wake for FUTEX_WAKE
+ *	 OUTPUT: FUTEX_WAIT: 0 once woken; FUTEX_WAKE: number woken;
+ *           -1 if unsuccessful
+ *	 SIDE EFFECTS: may block the process
+ */
+int32_t futex(uint32_t* addr, int32_t op, uint32_t val){
+	if(op == FUTEX_WAIT) return futex_wait(addr, val);
+	if(op == FUTEX_WAKE) return futex_wake(addr, val);
+	return -1;
+}
+
+/* memstat
+ *   DESCRIPTION: copies out the memory use counters of a process
+ *   INPUT: pid - process to look at, -1 for the current one
+ *          buf - user buffer for a mem_stats_t
+ *	 OUTPUT: 0 if successful, -1 if there is no such process or buf is bad
+ */
+int32_t memstat(int32_t pid, void* buf){
+	pcb_t* pcb = get_curr_proc();
+	mem_stats_t stats;
+	uint32_t flags;
+
+	if(bad_userspace_addr(buf, sizeof(mem_stats_t))) return -1;
+
+	cli_and_save(flags);
+	if(pid != -1){
+		// threads share their leader's address space, so look for that
+		for(pcb = process_list; pcb != NULL; pcb = pcb->next_proc){
+			if((int32_t)pcb->pid == pid) break;
+		}
+	}
+	if(pcb == NULL || pcb->state == PROC_ZOMBIE){
+		restore_flags(flags);
+		return -1;
+	}
+	stats = pcb->leader->mem.stats;
+	restore_flags(flags);
+
+	if(copy_to_user(buf, &stats, sizeof(mem_stats_t)) != 0) return -1;
+	return 0;
+}
+
+/* close_all_fds
+ *   DESCRIPTION: closes every file a halting process opened (not stdin and
+ *                stdout), so its pipe ends are dropped
+ *   INPUT: pcb - the current process
+ *	 OUTPUT: none
+ */
+void close_all_fds(pcb_t* pcb){
+	int j;
+	for(j = FIRST_AVAILABLE_FD; j < pcb->fd_count; ++j){
+		if(pcb->fd_array[j].flags != 0) close(j);
+	}
+}
+
+/* init_fd_table
+ *   DESCRIPTION: sets up the inline file descriptor table of a new process,
+ *                with only stdin and stdout open
+ *   INPUT: pcb - the new process
+ *	 OUTPUT: none
+ */
+void init_fd_table(pcb_t* pcb){
+	fd_t fd_stdin = {&stdin_ftable, 0, 0, 1, NULL};
+	fd_t fd_stdout = {&stdout_ftable, 0, 0, 1, NULL};
+
+	memset(pcb->fd_inline, 0, sizeof(pcb->fd_inline));
+	memset(pcb->fd_free, 0, sizeof(pcb->fd_free));
+	pcb->fd_array = pcb->fd_inline;
+	pcb->fd_count = FD_ARRAY_SIZE;
+	pcb->fd_array[0] = fd_stdin;
+	pcb->fd_array[1] = fd_stdout;
+	pcb->fd_free[0] = ((1 << FD_ARRAY_SIZE) - 1) & ~((1 << FIRST_AVAILABLE_FD) - 1);
+}
+
+/* alloc_fd_table
+ *   DESCRIPTION: takes a spilled file descriptor table from its cache,
+ *                making the cache on first use
+ *   INPUT: none
+ *	 OUTPUT: the table (not cleared), NULL if no memory is left
+ */
+static fd_t* alloc_fd_table(void){
+	if(fd_table_cache == NULL)
+		fd_table_cache = kmem_cache_create((const int8_t*)"fd_table", FD_MAX_NUM * sizeof(fd_t));
+	return (fd_t*)kmem_cache_alloc(fd_table_cache);
+}
+
+/* copy_fd_table
+ *   DESCRIPTION: gives a forked child its own copy of the parent's file
+ *                descriptor table (the pcb was copied already)
+ *   INPUT: child, parent - the two processes
+ *	 OUTPUT: 0 if successful, -1 if no memory is left for a spilled table
+ */
+int32_t copy_fd_table(pcb_t* child, pcb_t* parent){
+	if(parent->fd_array == parent->fd_inline){
+		child->fd_array = child->fd_inline;
+		return 0;
+	}
+	child->fd_array = alloc_fd_table();
+	if(child->fd_array == NULL) return -1;
+	memcpy(child->fd_array, parent->fd_array, FD_MAX_NUM * sizeof(fd_t));
+	return 0;
+}
+
+/* free_fd_table
+ *   DESCRIPTION: gives back a spilled file descriptor table
+ *   INPUT: pcb - process whose files are all closed
+ *	 OUTPUT: none
+ */
+void free_fd_table(pcb_t* pcb){
+	if(pcb->fd_array != pcb->fd_inline) kfree(pcb->fd_array);
+	pcb->fd_array = pcb->fd_inline;
+	pcb->fd_count = 0;
+}
+
+/* alloc_fd
+ *   DESCRIPTION: claims the lowest free fd from the free bitmap. When the
+ *                inline table is full it spills into an allocated table of
+ *                FD_MAX_NUM entries.
+ *   INPUT: pcb - current process
+ *	 OUTPUT: the fd, -1 if there are FD_MAX_NUM files open already or no
+ *           memory is left
+ */
+int32_t alloc_fd(pcb_t* pcb){
+	uint32_t j;
+	int32_t fd;
+	fd_t* table;
+
+	for(j = 0; j < FD_MAX_NUM / 32; j++){
+		if(pcb->fd_free[j] != 0) break;
+	}
+
+	if(j == FD_MAX_NUM / 32){
+		/* inline table full: spill; already spilled: out of fds */
+		if(pcb->fd_array != pcb->fd_inline) return -1;
+		table = alloc_fd_table();
+		if(table == NULL) return -1;
+		memset(table, 0, FD_MAX_NUM * sizeof(fd_t));
+		memcpy(table, pcb->fd_inline, sizeof(pcb->fd_inline));
+		pcb->fd_array = table;
+		pcb->fd_count = FD_MAX_NUM;
+		memset(pcb->fd_free, 0xFF, sizeof(pcb->fd_free));
+		pcb->fd_free[0] &= ~((1 << FD_ARRAY_SIZE) - 1);
+		j = 0;
+	}
+
+	// lowest set bit
+	asm volatile(
+		"bsfl %1, %0"
+		:"=r"(fd)
+		:"r"(pcb->fd_free[j])
+	);
+	pcb->fd_free[j] &= ~(1 << fd);
+	return j * 32 + fd;
+}
+
+/* release_fd
+ *   DESCRIPTION: clears an fd and marks it free
+ *   INPUT: pcb - current process
+ *          fd - fd to release
+ *	 OUTPUT: none
+ */
+void release_fd(pcb_t* pcb, int32_t fd){
+	memset(&pcb->fd_array[fd], 0, sizeof(fd_t));
+	pcb->fd_free[fd >> 5] |= (1 << (fd & 31));
+}
+
+/* fd_is_open
+ *   DESCRIPTION: checks an fd passed in by a system call
+ *   INPUT: pcb - current process
+ *          fd - fd to check
+ *	 OUTPUT: 1 if fd is in range and open, 0 if not
+ */
+int32_t fd_is_open(pcb_t* pcb, int32_t fd){
+	return fd >= 0 && (uint32_t)fd < pcb->fd_count && pcb->fd_array[fd].flags != 0;
+}
+
+/* reap_process
+ *   DESCRIPTION: forgets a halted process for good; its pid (and kernel
+ *                stack) can be reused from now on
+ *   INPUT: pcb - the halted process
+ *	 OUTPUT: none
+ */
+void reap_process(pcb_t* pcb){
+	sched_remove(pcb);
+	free_process(pcb);
+}
+
+/* orphan_children
+ *   DESCRIPTION: a process is going away; reap its zombie children and detach
+ *                the running ones, which then reap themselves when they halt
+ *   INPUT: pcb - the process going away
+ *	 OUTPUT: none
+ */
+void orphan_children(pcb_t* pcb){
+	pcb_t* child;
+	pcb_t* next;
+
+	for(child = process_list; child != NULL; child = next){
+		next = child->next_proc; // reaping unlinks child
+		if(child->parent != pcb || !child->spawned) continue;
+		if(child->state == PROC_ZOMBIE) reap_process(child);
+		else child->parent = NULL;
+	}
+}
+
+/* halt_spawned
+ *   DESCRIPTION: halt for processes started by spawn/fork. Releases
+ *                everything but the pcb, then leaves a zombie for the
+ *                parent's wait (or reaps itself if it has no parent) and
+ *                switches away for good.
+ *   INPUT: pcb - the current process
+ *          status - halt status
+ *	 OUTPUT: none, never returns
+ */
+void halt_spawned(pcb_t* pcb, uint8_t status){
+	close_all_fds(pcb);
+	free_fd_table(pcb);
+	orphan_children(pcb);
+	shm_detach_all(pcb);
+	free_process_memory(&pcb->mem);
+
+	pcb->exit_status = status;
+	if(pcb->parent == NULL){
+		// nobody waits for us; schedule_exit frees the stack we are on
+		sched_remove(pcb);
+		free_pid(pcb);
+		schedule_exit(pcb);
+	}
+	pcb->state = PROC_ZOMBIE;
+	wake_up(pcb->parent);
+	schedule_exit(NULL);
+}
+
+/* halt_thread
+ *   DESCRIPTION: halt for a thread other than the first of its process;
+ *                only the thread goes away. It reaps itself and switches
+ *                away for good.
+ *   INPUT: pcb - the current thread
+ *	 OUTPUT: none, never returns
+ */
+void halt_thread(pcb_t* pcb){
+	orphan_children(pcb);
+	sched_remove(pcb);
+	free_pid(pcb);
+	schedule_exit(pcb); // frees the stack we are on
+}
+
+/* kill_threads
+ *   DESCRIPTION: the process is ending; takes down its other threads. They
+ *                are not running (we are), so they are just dropped along
+ *                with whatever they were blocked on.
+ *   INPUT: leader - first thread of the process, the current one
+ *	 OUTPUT: none
+ */
+void kill_threads(pcb_t* leader){
+	pcb_t* pcb;
+
+	// start over after each one, reaping may unlink more than the thread
+	do{
+		for(pcb = process_list; pcb != NULL; pcb = pcb->next_proc){
+			if(pcb->leader == leader && pcb != leader) break;
+		}
+		if(pcb != NULL){
+			orphan_children(pcb);
+			reap_process(pcb);
+		}
+	}while(pcb != NULL);
+}
 
 /* ///EXECUTE HELPER FUNCTIONS/// */
 
@@ -473,21 +1182,94 @@ int32_t execute_setup(uint8_t* args, uint8_t* fname){
 		 exe_check[2] != exe_B2 || exe_check[3] != exe_B3)
 		 return -1;
 
-	i = 0;
-	while(i < MAX_PROCESS_NUM && pid_bits[i] == 1) i++;
+	available_pcb = alloc_process();
+	if(available_pcb == NULL) return -1;
+	// loading the image faults its pages in, which checks these
+	available_pcb->heap_end = USER_HEAP_START;
+	available_pcb->stack_limit = USER_STACK_DEFAULT_LIMIT;
 
-	// if max process reached, ret -1
-	if(i == MAX_PROCESS_NUM) return -1;
-	available_pid = i;
-
-	pid_bits[available_pid] = 1;
 	// otherwise, allocate page
-	set_process_memory(available_pid);
+	if(alloc_process_memory(&available_pcb->mem) == -1){
+		free_process(available_pcb);
+		return -1;
+	}
+	set_process_memory(&available_pcb->mem);
 
 	//assume the step passed
 	return 0;
 }
 
+/* execute_load
+ *   DESCRIPTION: execute helper function, steps 1 ~ 5 shared by execute and
+ *                spawn: parse the command, check the executable, allocate its
+ *                page, load it and create its pcb
+ *   INPUT: command: filename of the executable and the arguments of the
+ *                   command, a user string already checked to be
+ *                   in user space, or a kernel one
+ *	 OUTPUT: the new pcb, registered with the scheduler; NULL if unsuccessful
+ *           or command can't be read
+ *	 SIDE EFFECTS: leaves the new process's page loaded
+ */
+pcb_t* execute_load(const uint8_t* command){
+	pcb_t* current_pcb = get_running_pcb();
+	uint8_t cmd[COMMAND_SIZE];
+	int32_t len;
+
+	/* copy the command in first: it may be unmapped, and the caller's page
+	 * isn't mapped anymore once the new process's is loaded. Callers check
+	 * a user command is in user space. */
+	if(command == NULL) return NULL;
+	len = safe_strncpy((int8_t*)cmd, (const int8_t*)command, COMMAND_SIZE);
+	if(len == -1 || len == COMMAND_SIZE) return NULL; // faulted, or too long
+	command_buf = cmd;
+	command_len = len;
+	uint8_t fname[command_len+1]; // name of the executable
+	uint8_t args[command_len+1];
+	memset(fname,'\0',command_len+1); // clear buf
+	memset(args,'\0',command_len+1); // clear buf
+
+  /* step 1. parse arguments */
+	/* step 2. check to see if valid executable */
+  /* step 3. set pid bit and allocate page */
+	if(execute_setup(args, fname) == -1) return NULL;
+
+  /* step 4. load the filedata into the allocated page */
+	// read file content into corresponding phys addr
+	if(read_data(opened_file.inode_num, 0, (uint8_t*)FILE_LOCATION, PAGE_SIZE)==-1){
+		free_process_memory(&available_pcb->mem);
+		free_process(available_pcb);
+		if(current_pcb != NULL) set_process_memory(&current_pcb->leader->mem);
+		return NULL;
+	}
+
+  /* step 5. create pcb and populate it */
+	pcb_t* pcb_new = available_pcb;
+	execute_fillpcb(pcb_new);
+	if(terminal_arr[terminal_num].active == OFF){
+		terminal_arr[terminal_num].active = ON;
+		pcb_new->parent = NULL;
+		pcb_new->tid = terminal_num;
+	}
+	else{
+		pcb_new->parent = (pcb_t*)get_curr_pcb();
+		pcb_new->tid = pcb_new->parent->tid;
+	}
+
+	// set args
+	strcpy((int8_t*)pcb_new->args, (int8_t*)&(args));
+	pcb_new->args_size = size_of_args;
+
+  pcb_new->esp = USER_STACK_TOP - sizeof(void *);
+  // set executable code's eip to pcb's eip
+  read_data(opened_file.inode_num, EIP_ADDR_OFFSET, (uint8_t*)(&(pcb_new->eip)), EIP_ADDR_SIZE); // 24~27B holds eip
+
+	pcb_new->spawned = 0;
+	pcb_new->exit_status = 0;
+	pcb_new->shm_mask = 0;
+	sched_add(pcb_new);
+	return pcb_new;
+}
+
 /* execute_fillpcb
  *   DESCRIPTION: execute helper function, does part of the pcb step 4 to fill the passed in pcb
  *   INPUT: the pointer to the new pcb to fill
@@ -497,25 +1279,13 @@ int32_t execute_setup(uint8_t* args, uint8_t* fname){
  */
 void execute_fillpcb(pcb_t* pcb_new){
 	// set parent
-	if(available_pid == 0) pcb_new->parent = NULL;
+	if(pcb_new->pid == 0) pcb_new->parent = NULL;
 	else{
 		pcb_new -> parent = (pcb_t*)get_curr_pcb();
 	}
 
 	// create fd entries
-	fd_t fd_stdin = {&stdin_ftable, 0, 0, 1};
-	fd_t fd_stdout = {&stdout_ftable, 0, 0, 1};
-
-	// fill pcb
-	pcb_new->pid = available_pid;
-	pcb_new->fd_array[0] = fd_stdin;
-	pcb_new->fd_array[1] = fd_stdout;
-	for(i=FIRST_AVAILABLE_FD;i<FD_ARRAY_SIZE;++i){
-		pcb_new->fd_array[i].fxn_tbl_ptr =  NULL;
-		pcb_new->fd_array[i].inode = 0;
-		pcb_new->fd_array[i].file_pos = 0;
-		pcb_new->fd_array[i].flags = 0;
-	}
+	init_fd_table(pcb_new);
 }
 
 /* execute_cswitch
@@ -555,3 +1325,4 @@ void execute_cswitch(pcb_t* pcb_new){
   /* step 7. IRET, go to userspace */
   asm volatile("iret;");
 }
+
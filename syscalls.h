@@ -21,6 +21,8 @@
 #define KERNEL_STACK_START 0x00800000
 
 #define KERNEL_STACK_SIZE      0x2000
+/* top of the kernel stack a pcb sits at the bottom of (tss.esp0 while it runs) */
+#define KERNEL_STACK_TOP(pcb)  ((uint32_t)(pcb) + KERNEL_STACK_SIZE - sizeof(void *))
 
 #define VIRTUAL_ADDR_START 0x08000000
 
@@ -29,7 +31,8 @@
 #define EIP_ADDR_OFFSET            24
 #define EIP_ADDR_SIZE               4
 
-#define MAX_PROCESS_NUM             6
+#define MAX_PROCESS_NUM          1024 // pids; kernel stacks and pcbs are allocated
+                                      // as needed, so memory is the real limit
 #define EXE_CHECK_BYTENUM           4
 
 #define FILE_LOCATION      0x08048000 // 128MB in virtual mmr; but
@@ -38,10 +41,31 @@
 
 #define PCB_CALC_OFFSET 	0xFFFFE000 // calculate addr of current pcb
 
-#define EFLAGS_IF_MASK		0x00000020 // mask to set EFLAG's IF to 1 for STI
+#define EFLAGS_IF_MASK		0x00000200 // mask to set EFLAG's IF to 1 for STI
 #define BUF_SIZE								 128
-#define FD_ARRAY_SIZE							 8
+#define COMMAND_SIZE							 (2 * BUF_SIZE) // longest command execute takes, with the NUL
+#define FD_ARRAY_SIZE							 8 // fds kept inline in the pcb
+#define FD_MAX_NUM               128 // fds once spilled to an allocated table
 #define FIRST_AVAILABLE_FD         2
+#define SHM_MAX_SEGMENTS           8 // shared memory segments system wide
+#define NUM_SIGNALS                5 // see signal.h
+
+#define SYSCALL_FRAME_SIZE        15 // dwords: 10 saved by SYSTEM_CALL, 5 pushed by the cpu
+/* dword offsets into a syscall frame, from its lowest address */
+#define SYSCALL_FRAME_FS           1
+#define SYSCALL_FRAME_ES           2
+#define SYSCALL_FRAME_DS           3
+#define SYSCALL_FRAME_EBP          4
+#define SYSCALL_FRAME_EDI          5
+#define SYSCALL_FRAME_ESI          6
+#define SYSCALL_FRAME_EDX          7
+#define SYSCALL_FRAME_ECX          8
+#define SYSCALL_FRAME_EBX          9
+#define SYSCALL_FRAME_EIP         10
+#define SYSCALL_FRAME_CS          11
+#define SYSCALL_FRAME_EFLAGS      12
+#define SYSCALL_FRAME_ESP         13
+#define SYSCALL_FRAME_SS          14
 
 /* Structures regarding pcb below */
 
@@ -50,6 +74,8 @@ typedef uint32_t (*open_t)(const uint8_t*);
 typedef uint32_t (*close_t)(int32_t);
 typedef uint32_t (*read_t)(int32_t, void*, int32_t);
 typedef uint32_t (*write_t)(int32_t, const void*, int32_t);
+typedef struct poll_table_t poll_table_t; // see poll.h
+typedef uint32_t (*poll_t)(int32_t, poll_table_t*);
 
 /* file operations table pointer; jump table to diff syscalls */
 typedef struct{
@@ -57,6 +83,7 @@ typedef struct{
     close_t close;
     read_t read;
     write_t write;
+    poll_t poll; // readiness for poll (see poll.h), NULL: always ready
 }fops_table;
 
 
@@ -66,6 +93,7 @@ typedef struct{
     uint32_t inode;
     uint32_t file_pos;
     uint32_t flags;
+    void * data; // per-file kernel object (the pipe_t of a pipe end)
 }fd_t;
 
 
@@ -75,7 +103,11 @@ typedef struct pcb_t{
 
   struct pcb_t* parent;
 
-	uint8_t pid; // holds pid of this process
+	struct pcb_t* leader; // process this thread belongs to (itself for the
+	                      // first thread); it holds the files, memory, heap,
+	                      // shared memory and signal handlers of all threads
+
+	uint32_t pid; // holds pid of this process
 
 	uint8_t tid; // holds terminal id (0,1,2)
 
@@ -89,19 +121,67 @@ typedef struct pcb_t{
 	uint32_t ebp;
 	uint32_t eip;
 	uint32_t esp;
-	fd_t fd_array[FD_ARRAY_SIZE];   // holds file descriptor tables
+	fd_t* fd_array;                  // holds file descriptor tables: fd_inline,
+	                                 // or an allocated one after it filled up
+	uint32_t fd_count;               // entries in fd_array
+	uint32_t fd_free[FD_MAX_NUM / 32]; // bit set = fd is free
+	fd_t fd_inline[FD_ARRAY_SIZE];
 	uint8_t args[BUF_SIZE];  // holds the args
 	int args_size;
 
+	/* scheduling info; see sched.h */
+	uint8_t state;       // PROC_RUNNABLE, PROC_BLOCKED, ...
+	uint8_t spawned;     // 1 if started by spawn/fork: halt leaves a zombie
+	                     // for wait instead of returning into the parent
+	int32_t exit_status; // halt status kept for wait
+	uint32_t sched_ebp;  // ebp to resume on when switched out
+	void* wait_chan;     // what a blocked process sleeps on
+	void* futex_owner;   // futex a process sleeps on (see futex.c): its
+	uint32_t futex_addr; // address space and user address, or NULL and the
+	                     // physical address for shared memory
+	poll_table_t* poll_table; // what a process blocked in poll sleeps on
+
+	uint32_t shm_mask;   // bit i set: shared memory segment i is attached
+	uint32_t heap_end;   // program break, USER_HEAP_START ~ USER_HEAP_END
+	uint32_t stack_limit; // bytes the user stack may grow to (see paging.h)
+	void* sig_handler[NUM_SIGNALS]; // user handlers, NULL for the default action
+	uint32_t sig_pending; // bit i set: signal i waits to be delivered
+	uint8_t sig_masked;  // 1 while a handler runs, until sigreturn
+	uint8_t group_exit;  // leader only: a thread took a fatal signal, the
+	                     // process ends on its next return to user mode
+	user_mem_t mem;      // page tables of the address space
+
+	struct pcb_t* next_proc; // process list, see sched.c
+	struct pcb_t* prev_proc;
+
 }pcb_t;
 
 /* helper functions */
 
 void* get_curr_pcb(void); /* gets the addr of current pcb based on current esp */
+pcb_t* get_curr_proc(void); /* pcb holding the resources of the current thread's process */
+pcb_t* alloc_process(void); /* claims a free pid and a kernel stack for its pcb, NULL if none left */
+void free_process(pcb_t* pcb); /* gives both back */
+void free_pid(pcb_t* pcb); /* gives back only the pid (a process reaping itself) */
 /*execute's helper subroutines/steps*/
 int32_t execute_setup(uint8_t* args, uint8_t* fname); //completes steps 1 2 and 3, of null checking, parsing the command, and allocating the new page
 void execute_fillpcb(pcb_t* pcb_new); //fills the input pointer pcb with the values, mostly gathered from get_curr_pcb helper
 void execute_cswitch(pcb_t* pcb_new); /* executes context switching based off of the new pcb sent to it */
+pcb_t* execute_load(const uint8_t* command); /* steps 1-5 of execute, shared with spawn; NULL if unsuccessful */
+/*halt's helpers for spawned/forked processes*/
+void halt_spawned(pcb_t* pcb, uint8_t status); /* leaves a zombie (or reaps itself) and switches away, never returns */
+void orphan_children(pcb_t* pcb); /* reaps zombie children, detaches running ones */
+void halt_thread(pcb_t* pcb); /* ends a thread that is not the first of its process, never returns */
+void kill_threads(pcb_t* leader); /* drops the other threads of an ending process */
+void reap_process(pcb_t* pcb); /* frees a halted process's pid */
+void close_all_fds(pcb_t* pcb); /* closes every file the (current) process has open */
+/*file descriptor table*/
+void init_fd_table(pcb_t* pcb); /* inline table with stdin and stdout open */
+int32_t copy_fd_table(pcb_t* child, pcb_t* parent); /* fork's copy, -1 if no memory */
+void free_fd_table(pcb_t* pcb); /* frees a spilled table */
+int32_t alloc_fd(pcb_t* pcb); /* claims the lowest free fd, -1 if none */
+void release_fd(pcb_t* pcb, int32_t fd); /* makes fd free again */
+int32_t fd_is_open(pcb_t* pcb, int32_t fd); /* 1 if fd is a valid, open fd */
 
 
 /* system call declarations */
@@ -154,6 +234,68 @@ we immediately return failure from these calls.*/
 int32_t set_handler(int32_t signum, void* handler_address);
 int32_t sigreturn(void);
 
+/*The fork system call duplicates the calling process. The child gets a copy of the parent's pcb (open files, args,
+terminal) and shares all of its user pages copy-on-write, so a page is only copied when one side writes to it. Both
+keep running: the child returns 0, the parent returns the child's pid. Returns -1 if no pid or page table is available.*/
+int32_t fork(void);
+
+/*The spawn system call loads a program like execute, but returns the new child's pid right away instead of waiting
+for it to halt; parent and child then run concurrently in the same terminal. Returns -1 if the command cannot be
+executed.*/
+int32_t spawn(const uint8_t* command);
+
+/*The wait system call blocks until any child started by spawn or fork halts, stores its halt status into *status
+(if status is not NULL) and returns its pid. Returns -1 if the caller has no such child.*/
+int32_t wait(int32_t* status);
+
+/*The waitpid system call is wait for one specific child pid (or any child if pid is -1).*/
+int32_t waitpid(int32_t pid, int32_t* status);
+
+/*The pipe system call creates a pipe and stores a file descriptor for its read end in fds[0] and one for its write end
+in fds[1]. Reads block while the pipe is empty and return 0 once every write end is closed; writes block while it is
+full. Page-aligned whole pages are passed by remapping rather than copying. Returns -1 if fds is not in the user page
+or two descriptors are not free.*/
+int32_t pipe(int32_t* fds);
+
+/*The shmat system call maps the shared memory segment called name at addr, which must be page aligned and inside the
+user page, creating the segment (size bytes, zero filled) if no process has it yet. Every process attaching the same
+name sees the same memory; the segment is freed when the last process that attached it halts. Returns -1 if the
+arguments are bad or memory ran out.*/
+int32_t shmat(const uint8_t* name, void* addr, int32_t size);
+
+/*The brk system call sets the end of the process's heap (the program break) to addr. The heap starts out empty at
+USER_HEAP_START and is backed 4KB at a time, so a process only takes the pages below its break; new pages read as
+zero. Returns 0, or -1 if addr is outside the heap area or memory ran out.*/
+int32_t brk(void* addr);
+
+/*The sbrk system call moves the program break by increment bytes (which may be negative) and returns the old break,
+i.e. the start of the newly allocated memory. Returns -1 on failure, like brk.*/
+int32_t sbrk(int32_t increment);
+
+/*The poll system call waits until one of nfds file descriptors is ready. fds is an array of pollfd_t (see poll.h)
+whose events say what to wait for (POLLIN, POLLOUT); poll fills in revents. timeout is in milliseconds, 0 to just
+check and -1 to wait forever. Returns the number of ready entries, 0 on timeout or when a signal is pending, -1 if
+the arguments are bad.*/
+int32_t poll(void* fds, uint32_t nfds, int32_t timeout);
+
+/*The clone system call starts a new thread in the calling process. It shares the process's memory, files and signal
+handlers, but has its own kernel stack and registers. The thread starts at entry with its stack pointer just below
+stack (the top of memory the caller set aside for it) and arg as its only argument; returning from entry halts the
+thread with the returned value. Returns the thread's pid, or -1 if the arguments are bad or no pid or memory is left.*/
+int32_t clone(void* entry, void* stack, void* arg);
+
+/*The futex system call is the slow path of user space locks. FUTEX_WAIT sleeps as long as the word at addr holds
+val, and returns 0 once woken or -1 at once if the word changed. FUTEX_WAKE wakes up to val processes waiting on the
+word and returns how many it woke. Waiters are matched by address space and address of the word, or by its physical
+address in shared memory, so it works across threads and shared memory mappings. Returns -1 if addr is unaligned or
+not a user address.*/
+int32_t futex(uint32_t* addr, int32_t op, uint32_t val);
+
+/*The memstat system call copies the memory use of process pid (-1 for the caller) into buf, a mem_stats_t (see
+paging.h): resident pages, their peak, minor and major page faults and copy-on-write breaks. Threads report their
+process's address space. Returns 0, or -1 if there is no such process or buf is not writable.*/
+int32_t memstat(int32_t pid, void* buf);
+
 
 
 #endif /* SYSCALLS_H */
@@ -4,6 +4,8 @@
 #include "paging.h"
 #include "keyboard.h"
 #include "pit.h"
+#include "sched.h"
+#include "poll.h"
 
 
 /* terminal_open
@@ -61,24 +63,43 @@ int32_t terminal_read(int32_t fd, void * buf, int32_t nbytes){
   if((buf == NULL) | (nbytes < 0)){
     return -1;
   }
-  while(enter_flag != 1 || (terminal_num != terminal_num_display)){} // accept keyboard data until enter is pressed
   cli();
+  while(enter_flag != 1 || (terminal_num != terminal_num_display)){ // accept keyboard data until enter is pressed
+    sleep_on(&enter_flag); // woken by enter and by terminal switches
+  }
   enter_flag = 0;    // reset enter flag
   int cnt = 0;      //count of the letter in buffer (including enter)
   int32_t limit = nbytes > SCREEN_BUF_SIZE ? SCREEN_BUF_SIZE : nbytes; // limit upperbounded at 128
-  for (i = 0; i < limit; i++){ // put keyboard data into buffer
-    ((char *)buf)[i] = terminal_arr[terminal_num_display].screen_buf[i];
+  for (i = 0; i < limit; i++){ // count the keyboard data up to the enter
     cnt = cnt + 1;
     if((terminal_arr[terminal_num_display].screen_buf[i] == '\n') | (terminal_arr[terminal_num_display].screen_buf[i] == '\r')){
       break;
     }
   }
+  if(copy_to_user(buf, terminal_arr[terminal_num_display].screen_buf, cnt) != 0){ // put keyboard data into buffer
+    cnt = -1;
+  }
   clearbuf();
   sti();
   return cnt;
 }
 
 
+/* terminal_poll
+ *   DESCRIPTION: readiness of the terminal for poll
+ *   INPUT: fd - file number
+ *          table - table of the poll call in progress
+ *	 OUTPUT: POLLOUT, and POLLIN when a line is entered in the terminal
+ *	 SIDE EFFECTS: none
+ */
+uint32_t terminal_poll(int32_t fd, poll_table_t* table){
+  poll_wait(table, &enter_flag);
+  if(enter_flag == 1 && terminal_num == terminal_num_display){
+    return POLLIN | POLLOUT;
+  }
+  return POLLOUT;
+}
+
 /* terminal_write
  *   DESCRIPTION: writes data from screen buffer to video memory
  *                if the next letter to print is at the end of the screen,
@@ -100,7 +121,9 @@ int32_t terminal_write(int32_t fd, void* buf, int32_t nbytes){
    * return zero */
   cli();
   for (i = 0; i < nbytes; i++){
-    c = ((char *)buf)[i];
+    if(copy_from_user(&c, (char *)buf + i, 1) != 0){ // user page went missing
+      break;
+    }
 
     /* homage to putc function */
     if (terminal_arr[terminal_num].cursor_x == NUM_COLS){ // if end of the row, move to the next row
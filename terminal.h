@@ -32,6 +32,9 @@ int32_t terminal_close(int32_t fd, void* buf, int32_t nbytes);
 int32_t terminal_read(int32_t fd, void * buf, int32_t nbytes);
 /* write data stored in screen buffer */
 int32_t terminal_write(int32_t fd, void* buf, int32_t nbytes);
+struct poll_table_t; // see poll.h
+/* readable once enter is pressed, always writable; for poll */
+uint32_t terminal_poll(int32_t fd, struct poll_table_t * table);
 /* scroll up the terminal by one row */
 void scroll_up(void);
 /* update the cursor position */
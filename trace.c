@@ -0,0 +1,130 @@
+/* trace.c - system call tracing
+ * vim:ts=4 noexpandtab
+ */
+
+#include "trace.h"
+#include "lib.h"
+
+#define SYSCALL_HALT_INDEX		0 // 0 indexed, as SYSTEM_CALL passes them
+#define SYSCALL_SIGRETURN_INDEX	9
+
+typedef int32_t (*syscall_fxn_t)(uint32_t, uint32_t, uint32_t);
+extern syscall_fxn_t syscalls_fxns_jmp[]; // isr_wrapper.S
+
+uint32_t trace_enabled = 0;
+
+fops_table trace_ftable = {NULL, NULL, (read_t)trace_read, (write_t)trace_write};
+
+/* written by any process, read through the device file. Writers claim a
+ * slot by bumping trace_head atomically, so a process preempted halfway
+ * through a record can't collide with the next one; a full ring overwrites
+ * the oldest records. */
+static trace_entry_t trace_ring[TRACE_RING_SIZE];
+static volatile uint32_t trace_head = 0; // records claimed so far
+static uint32_t trace_tail = 0;          // next record to read
+
+/* read_tsc
+ *   DESCRIPTION: reads the time stamp counter
+ *   OUTPUT: cycles since reset
+ */
+static inline uint64_t read_tsc(void){
+	uint64_t tsc;
+	asm volatile("rdtsc" : "=A"(tsc));
+	return tsc;
+}
+
+/* trace_record
+ *   DESCRIPTION: claims the next slot of the ring and fills it in
+ *   INPUT: num - system call number, 0 indexed
+ *          args - its arguments
+ *          ret - its return value
+ *          tsc_entry, tsc_exit - when it came in and returned
+ *   OUTPUT: none
+ */
+static void trace_record(uint32_t num, uint32_t* args, int32_t ret,
+                         uint64_t tsc_entry, uint64_t tsc_exit){
+	uint32_t pos = 1;
+	trace_entry_t* e;
+
+	asm volatile("lock xaddl %0, %1" : "+r"(pos), "+m"(trace_head) : : "memory");
+	e = &trace_ring[pos & (TRACE_RING_SIZE - 1)];
+
+	e->seq = 0; // incomplete while it is written
+	e->pid = ((pcb_t*)get_curr_pcb())->pid;
+	e->num = num + 1;
+	memcpy(e->args, args, sizeof(e->args));
+	e->ret = ret;
+	e->tsc_entry = tsc_entry;
+	e->tsc_exit = tsc_exit;
+	asm volatile("" : : : "memory");
+	e->seq = pos + 1;
+}
+
+/* trace_syscall
+ *   DESCRIPTION: SYSTEM_CALL goes through here instead of calling the system
+ *                call directly while tracing is on. Calls that don't return
+ *                (halt, sigreturn) are recorded on the way in.
+ *   INPUT: num - system call number, 0 indexed and already checked
+ *          arg1, arg2, arg3 - its arguments
+ *   OUTPUT: what the system call returns
+ */
+int32_t trace_syscall(uint32_t num, uint32_t arg1, uint32_t arg2, uint32_t arg3){
+	uint32_t args[TRACE_NUM_ARGS] = {arg1, arg2, arg3};
+	uint64_t tsc_entry = read_tsc();
+	int32_t ret;
+
+	if(num == SYSCALL_HALT_INDEX || num == SYSCALL_SIGRETURN_INDEX)
+		trace_record(num, args, 0, tsc_entry, tsc_entry);
+
+	ret = syscalls_fxns_jmp[num](arg1, arg2, arg3);
+	trace_record(num, args, ret, tsc_entry, read_tsc());
+	return ret;
+}
+
+/* trace_read
+ *   DESCRIPTION: copies out the oldest unread records, whole records only.
+ *                Records overwritten before being read are skipped.
+ *   INPUT: fd - file number
+ *          buf - buffer for trace_entry_t records
+ *          nbytes - size of buf
+ *   OUTPUT: number of bytes read, 0 if there is nothing new
+ *   SIDE EFFECTS: the records read are consumed
+ */
+int32_t trace_read(int32_t fd, void* buf, int32_t nbytes){
+	trace_entry_t* out = (trace_entry_t*)buf;
+	trace_entry_t* e;
+	trace_entry_t copy;
+	uint32_t head = trace_head;
+	int32_t n = 0;
+
+	if(buf == NULL || nbytes < 0) return -1;
+
+	if(head - trace_tail > TRACE_RING_SIZE) trace_tail = head - TRACE_RING_SIZE;
+	while(trace_tail != head && (n + 1) * (int32_t)sizeof(trace_entry_t) <= nbytes){
+		e = &trace_ring[trace_tail & (TRACE_RING_SIZE - 1)];
+		if(e->seq != trace_tail + 1) break; // still being written
+		copy = *e;
+		// the writer may have lapped us while we copied
+		if(copy.seq != e->seq || trace_head - trace_tail > TRACE_RING_SIZE) break;
+		if(copy_to_user(&out[n], &copy, sizeof(trace_entry_t)) != 0) break;
+		trace_tail++;
+		n++;
+	}
+	return n * sizeof(trace_entry_t);
+}
+
+/* trace_write
+ *   DESCRIPTION: turns tracing on or off
+ *   INPUT: fd - file number
+ *          buf - holds a uint32_t, nonzero to trace
+ *          nbytes - must be 4
+ *   OUTPUT: 0 if successful, -1 if not
+ */
+int32_t trace_write(int32_t fd, const void* buf, int32_t nbytes){
+	uint32_t on;
+
+	if(buf == NULL || nbytes != sizeof(uint32_t) ||
+	   copy_from_user(&on, buf, sizeof(uint32_t)) != 0) return -1;
+	trace_enabled = (on != 0);
+	return 0;
+}
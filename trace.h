@@ -0,0 +1,40 @@
+/* trace.h - system call tracing
+ * vim:ts=4 noexpandtab
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+#include "syscalls.h"
+
+#define TRACE_RING_SIZE		256 // records kept, a power of two
+#define TRACE_DEVICE_NAME	"trace" // device file the records are read from
+#define TRACE_NUM_ARGS		3
+
+/* one traced system call. seq is written last: the record is complete
+ * once it holds the slot's sequence number. */
+typedef struct trace_entry_t{
+	uint32_t seq;		// 1 + position in the stream of records
+	uint32_t pid;
+	uint32_t num;		// system call number (1 = halt, ...)
+	uint32_t args[TRACE_NUM_ARGS];
+	int32_t ret;
+	uint32_t pad;
+	uint64_t tsc_entry;	// time stamp counter when the call came in
+	uint64_t tsc_exit;	// and when it returned
+}trace_entry_t;
+
+/* nonzero while system calls are traced; checked by SYSTEM_CALL */
+extern uint32_t trace_enabled;
+
+extern fops_table trace_ftable;
+
+/* runs system call num (0 indexed) and records it; called by SYSTEM_CALL */
+int32_t trace_syscall(uint32_t num, uint32_t arg1, uint32_t arg2, uint32_t arg3);
+
+/* trace device file operations */
+int32_t trace_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t trace_write(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif /* TRACE_H */